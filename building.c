@@ -12,6 +12,10 @@ void building_init(Building* building) {
     if (building == NULL) return;
     roomarray_init(&(building->rooms));
     ghostlist_init(&(building->ghosts));
+    ghostindex_init(&(building->index));
+    building->merge_policy = MERGE_MAX;
+    building->deduplicated = 0;
+    subscription_registry_init(&(building->subscriptions));
 }
 
 /*
@@ -24,6 +28,10 @@ void building_init(Building* building) {
 void building_cleanup(Building* building) {
     if (building == NULL) return;
 
+    // 0. Free nodes and ghosts still waiting out an epoch grace period.
+    //    No reader may be inside a read section at this point.
+    epoch_drain();
+
     // 1. Clean up all the Room objects and their GhostList *nodes*
     //    (but not the Ghost data itself).
     roomarray_cleanup(&(building->rooms));
@@ -32,6 +40,131 @@ void building_cleanup(Building* building) {
     //    This frees both the nodes and the Ghost data.
     //    This is safe because step 1 did not free the Ghost data.
     ghostlist_cleanup(&(building->ghosts), true);
+
+    // 3. Free the (type, room) index; its ghosts are already gone.
+    ghostindex_cleanup(&(building->index));
+
+    // 4. Free the building's subscriptions and queued alerts.
+    subscription_registry_cleanup(&(building->subscriptions));
+}
+
+/*
+  Function: building_flush
+  Purpose:  Merges the pending ghosts of every deferred room, e.g. at the end
+            of an ingest burst. This is a write:
+            with concurrent writers the caller must hold epoch_write_lock.
+  Params:
+    in/out: building - The building to flush.
+*/
+void building_flush(Building* building) {
+    if (building == NULL) return;
+
+    for (int i = 0; i < building->rooms.size; i++) {
+        room_flush(building->rooms.elements[i]);
+    }
+}
+
+/*
+  Function: building_add_room
+  Purpose:  Adds a room to the building and connects it to the building's
+            subscriptions, so sightings in it raise the building's alerts.
+  Params:
+    in/out: building - The building to add to.
+    in/out: room     - The room to add.
+*/
+void building_add_room(Building* building, Room* room) {
+    if (building == NULL || room == NULL) return;
+
+    int size = building->rooms.size;
+    roomarray_add(&(building->rooms), room);
+    if (building->rooms.size > size) {
+        room->subscriptions = &(building->subscriptions);
+    }
+}
+
+/*
+  Function: building_remove_ghost
+  Purpose:  Removes a ghost from its room and from the building's main list.
+            The ghost is retired rather than freed so concurrent epoch readers
+            can finish with it. Callers with concurrent writers must hold
+            epoch_write_lock.
+  Params:
+    in/out: building - The building that owns the ghost.
+    in/out: ghost    - The ghost to remove.
+  Returns:  true if the ghost was found in the building, false otherwise.
+*/
+bool building_remove_ghost(Building* building, Ghost* ghost) {
+    if (building == NULL || ghost == NULL) return false;
+
+    if (!ghostlist_remove(&(building->ghosts), ghost)) return false;
+    if (ghost->room != NULL) {
+        room_remove_ghost(ghost->room, ghost);
+        ghostindex_remove(&(building->index), ghost, ghost->room->id);
+    }
+
+    epoch_retire(ghost, free);
+    return true;
+}
+
+/*
+  Function: building_upsert_ghost
+  Purpose:  Records a sighting of `type` in `room`. If the building already
+            has a ghost of that type in that room, its likelihood is merged
+            according to building->merge_policy and it is repositioned in the
+            room's list; otherwise a new ghost is created and added.
+  Params:
+    in/out: building   - The building to record the sighting in.
+    in:     type       - The ghost type that was sighted.
+    in/out: room       - The room it was sighted in.
+    in:     likelihood - The reported likelihood.
+  Returns:  The new or updated ghost, or NULL on bad arguments.
+*/
+Ghost* building_upsert_ghost(Building* building, const char* type, Room* room, float likelihood) {
+    if (building == NULL || type == NULL || room == NULL) return NULL;
+
+    GhostIndexEntry* entry = ghostindex_find(&(building->index), type, room->id);
+    if (entry == NULL) {
+        util_ghost_create_and_add(building, type, room, likelihood);
+        return building->ghosts.tail->data;
+    }
+
+    Ghost* ghost = entry->ghost;
+    entry->reports++;
+    building_merge_report(building, ghost, likelihood, entry->reports);
+    building->deduplicated++;
+    return ghost;
+}
+
+/*
+  Function: building_merge_report
+  Purpose:  Merges a repeat report into an existing ghost according to
+            building->merge_policy and repositions it in its room's list.
+            Only the writer that owns the ghost's room may call this.
+  Params:
+    in:     building   - The building whose merge policy applies.
+    in/out: ghost      - The ghost the report repeats.
+    in:     likelihood - The reported likelihood.
+    in:     reports    - Reports merged into the ghost, counting this one.
+*/
+void building_merge_report(const Building* building, Ghost* ghost, float likelihood, int reports) {
+    if (building == NULL || ghost == NULL) return;
+
+    float merged = likelihood;
+    switch (building->merge_policy) {
+        case MERGE_MAX:
+            merged = ghost->likelihood > likelihood ? ghost->likelihood : likelihood;
+            break;
+        case MERGE_LATEST:
+            break;
+        case MERGE_AVERAGE:
+            // Running mean over every report merged into this ghost
+            merged = ghost->likelihood + (likelihood - ghost->likelihood) / reports;
+            break;
+    }
+
+    if (merged != ghost->likelihood) {
+        room_reposition_ghost(ghost->room, ghost, merged);
+    }
 }
 
 /* This is just a helper for the way that the sample data loads these */
@@ -40,6 +173,9 @@ void util_ghost_create_and_add(Building* building, const char* type, Room* room,
     ghost_create(&ghost, type);
     ghostlist_push(&building->ghosts, ghost);
     room_add_ghost(room, ghost, likelihood);
+    if (room != NULL) {
+        ghostindex_insert(&(building->index), ghost, room->id);
+    }
 }
 
 void building_load_sample(Building* building) {
@@ -47,21 +183,21 @@ void building_load_sample(Building* building) {
 
     // Create Rooms
     room_create(&bedroom, 1, "Bedroom");
-    roomarray_add(&building->rooms, bedroom);
+    building_add_room(building, bedroom);
     room_create(&bathroom, 2, "Bathroom");
-    roomarray_add(&building->rooms, bathroom);
+    building_add_room(building, bathroom);
     room_create(&living_room, 3, "Living Room");
-    roomarray_add(&building->rooms, living_room);
+    building_add_room(building, living_room);
     room_create(&kitchen, 4, "Kitchen");
-    roomarray_add(&building->rooms, kitchen);
+    building_add_room(building, kitchen);
     room_create(&basement, 5, "Basement");
-    roomarray_add(&building->rooms, basement);
+    building_add_room(building, basement);
     room_create(&garage, 6, "Garage");
-    roomarray_add(&building->rooms, garage);
+    building_add_room(building, garage);
     room_create(&hallway, 7, "Hallway");
-    roomarray_add(&building->rooms, hallway);
+    building_add_room(building, hallway);
     room_create(&staircase, 8, "Staircase");
-    roomarray_add(&building->rooms, staircase);
+    building_add_room(building, staircase);
 
     // Create Ghosts and add to Building GhostList and Rooms
     util_ghost_create_and_add(building, "Banshee", kitchen, 82.51f);
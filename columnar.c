@@ -0,0 +1,421 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "defs.h"
+
+/* This file contains the columnar export: sightings are split into blocks of
+   rows, and each column of a block is stored as a bit-packed chunk with its
+   min/max. Types are dictionary-encoded, ids are usually delta-encoded and
+   likelihoods are fixed point. The reader maps the file and skips whole
+   blocks whose stats rule out the predicate. Integers are stored in host
+   byte order, like the replica. */
+
+// Growable table of distinct type strings
+typedef struct ColumnarTypes {
+    char (*names)[MAX_STR];
+    uint32_t count;
+    uint32_t cap;
+} ColumnarTypes;
+
+static uint64_t columnar_align(uint64_t offset) {
+    return (offset + 7) & ~(uint64_t) 7;
+}
+
+static int columnar_bit_width(uint64_t range) {
+    int width = 0;
+    while (width < 64 && (range >> width) != 0) width++;
+    return width;
+}
+
+static uint64_t columnar_zigzag(int64_t value) {
+    return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+}
+
+static int64_t columnar_unzigzag(uint64_t value) {
+    return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+}
+
+/* Returns the dictionary index of a type, adding it if new */
+static uint32_t columnar_intern_type(ColumnarTypes* types, const char* type) {
+    // Newest types are the most likely to repeat, so search backwards
+    for (uint32_t i = types->count; i > 0; i--) {
+        if (strcmp(types->names[i - 1], type) == 0) return i - 1;
+    }
+    if (types->count == types->cap) {
+        uint32_t cap = types->cap == 0 ? 16 : types->cap * 2;
+        char (*grown)[MAX_STR] = realloc(types->names, sizeof(*grown) * cap);
+        if (grown == NULL) {
+            printf("Error: realloc failed in columnar_intern_type\n");
+            exit(1);
+        }
+        types->names = grown;
+        types->cap = cap;
+    }
+    memset(types->names[types->count], 0, MAX_STR);
+    strcpy(types->names[types->count], type);
+    return types->count++;
+}
+
+/* Picks the narrower of frame-of-reference and delta encoding for one chunk
+   and fills in its stats. Returns the number of packed bytes needed. */
+static size_t columnar_plan_chunk(const int32_t* values, uint32_t rows, ColumnarChunk* chunk) {
+    int32_t min = values[0], max = values[0];
+    uint64_t max_delta = 0;
+    for (uint32_t i = 1; i < rows; i++) {
+        if (values[i] < min) min = values[i];
+        if (values[i] > max) max = values[i];
+        uint64_t delta = columnar_zigzag((int64_t) values[i] - values[i - 1]);
+        if (delta > max_delta) max_delta = delta;
+    }
+
+    int for_width = columnar_bit_width((uint64_t) ((int64_t) max - min));
+    int delta_width = columnar_bit_width(max_delta);
+    memset(chunk, 0, sizeof(ColumnarChunk));
+    chunk->min = min;
+    chunk->max = max;
+    if (delta_width < for_width) {
+        chunk->encoding = COLUMNAR_DELTA;
+        chunk->bit_width = (uint8_t) delta_width;
+        chunk->base = values[0];
+    } else {
+        chunk->encoding = COLUMNAR_FOR;
+        chunk->bit_width = (uint8_t) for_width;
+        chunk->base = min;
+    }
+    chunk->size = (uint32_t) (((uint64_t) rows * chunk->bit_width + 7) / 8 + COLUMNAR_PADDING);
+    return chunk->size;
+}
+
+/* Packs a chunk's values into out, which must be chunk->size zeroed bytes */
+static void columnar_pack_chunk(const int32_t* values, uint32_t rows, const ColumnarChunk* chunk, unsigned char* out) {
+    uint64_t bits = 0;
+    int pending = 0;
+    int64_t previous = chunk->base;
+    for (uint32_t i = 0; i < rows; i++) {
+        uint64_t packed;
+        if (chunk->encoding == COLUMNAR_DELTA) {
+            packed = columnar_zigzag((int64_t) values[i] - previous);
+            previous = values[i];
+        } else {
+            packed = (uint64_t) ((int64_t) values[i] - chunk->base);
+        }
+
+        // At most 7 leftover bits plus 32 new ones, so this never overflows
+        bits |= packed << pending;
+        pending += chunk->bit_width;
+        while (pending >= 8) {
+            *out++ = (unsigned char) bits;
+            bits >>= 8;
+            pending -= 8;
+        }
+    }
+    if (pending > 0) *out = (unsigned char) bits;
+}
+
+/* Decodes a chunk into out[0 .. rows - 1] */
+static void columnar_unpack_chunk(const unsigned char* base, const ColumnarChunk* chunk, uint32_t rows, int32_t* out) {
+    const unsigned char* data = base + chunk->offset;
+    uint64_t mask = chunk->bit_width == 0 ? 0 : (~(uint64_t) 0 >> (64 - chunk->bit_width));
+    int64_t value = chunk->base;
+
+    for (uint32_t i = 0; i < rows; i++) {
+        // The chunk's padding makes an 8-byte read at any value's byte safe
+        uint64_t position = (uint64_t) i * chunk->bit_width;
+        uint64_t word;
+        memcpy(&word, data + position / 8, sizeof(word));
+        uint64_t packed = (word >> (position % 8)) & mask;
+
+        if (chunk->encoding == COLUMNAR_DELTA) {
+            value += columnar_unzigzag(packed);
+            out[i] = (int32_t) value;
+        } else {
+            out[i] = (int32_t) (chunk->base + (int64_t) packed);
+        }
+    }
+}
+
+/*
+  Function: columnar_export
+  Purpose:  Writes every ghost in the building's main list, in list order, to
+            a columnar file. Ghosts without a room get room id -1.
+  Params:
+    in: building   - The building to export.
+    in: path       - The file to create or replace.
+    in: block_rows - Rows per block, or 0 for COLUMNAR_BLOCK_ROWS. Smaller
+                     blocks skip more precisely but cost more stats.
+  Returns:  0 on success, -1 on failure.
+*/
+int columnar_export(const Building* building, const char* path, uint32_t block_rows) {
+    if (building == NULL || path == NULL) return -1;
+    if (block_rows == 0) block_rows = COLUMNAR_BLOCK_ROWS;
+
+    uint64_t row_count = 0;
+    for (GhostNode* curr = building->ghosts.head; curr != NULL; curr = curr->next) {
+        row_count++;
+    }
+
+    // Gather the columns; ids and room ids are ints, likelihoods are in hundredths
+    int32_t* columns[COLUMNAR_COLUMNS];
+    for (int c = 0; c < COLUMNAR_COLUMNS; c++) {
+        columns[c] = (int32_t*) malloc(sizeof(int32_t) * (row_count > 0 ? row_count : 1));
+        if (columns[c] == NULL) {
+            printf("Error: malloc failed in columnar_export\n");
+            exit(1);
+        }
+    }
+    ColumnarTypes types = { NULL, 0, 0 };
+    uint64_t row = 0;
+    for (GhostNode* curr = building->ghosts.head; curr != NULL; curr = curr->next, row++) {
+        Ghost* ghost = curr->data;
+        columns[COLUMNAR_ID][row] = ghost->id;
+        columns[COLUMNAR_TYPE][row] = (int32_t) columnar_intern_type(&types, ghost->type);
+        columns[COLUMNAR_ROOM][row] = ghost->room != NULL ? ghost->room->id : -1;
+        columns[COLUMNAR_LIKELIHOOD][row] = packed_quantize_likelihood(ghost->likelihood);
+    }
+
+    ColumnarHeader header;
+    memset(&header, 0, sizeof(header));
+    strcpy(header.magic, COLUMNAR_MAGIC);
+    header.version = COLUMNAR_VERSION;
+    header.block_rows = block_rows;
+    header.row_count = row_count;
+    header.block_count = (uint32_t) ((row_count + block_rows - 1) / block_rows);
+    header.type_count = types.count;
+    header.room_count = (uint32_t) building->rooms.size;
+    header.types_offset = columnar_align(sizeof(ColumnarHeader));
+    header.rooms_offset = columnar_align(header.types_offset + (uint64_t) MAX_STR * header.type_count);
+    header.blocks_offset = columnar_align(header.rooms_offset + sizeof(ColumnarRoom) * header.room_count);
+
+    // Plan every chunk so the directory can be written before the data
+    ColumnarBlock* blocks = (ColumnarBlock*) calloc(header.block_count > 0 ? header.block_count : 1,
+                                                    sizeof(ColumnarBlock));
+    if (blocks == NULL) {
+        printf("Error: calloc failed in columnar_export\n");
+        exit(1);
+    }
+    uint64_t offset = header.blocks_offset + sizeof(ColumnarBlock) * header.block_count;
+    size_t max_chunk = 0;
+    for (uint32_t b = 0; b < header.block_count; b++) {
+        uint64_t first = (uint64_t) b * block_rows;
+        blocks[b].rows = (uint32_t) (row_count - first < block_rows ? row_count - first : block_rows);
+        for (int c = 0; c < COLUMNAR_COLUMNS; c++) {
+            size_t size = columnar_plan_chunk(columns[c] + first, blocks[b].rows, &(blocks[b].columns[c]));
+            blocks[b].columns[c].offset = offset;
+            offset += size;
+            if (size > max_chunk) max_chunk = size;
+        }
+    }
+    header.file_size = offset;
+
+    int result = -1;
+    unsigned char* chunk = (unsigned char*) malloc(max_chunk > 0 ? max_chunk : 1);
+    FILE* file = fopen(path, "wb");
+    if (chunk == NULL) {
+        printf("Error: malloc failed in columnar_export\n");
+        exit(1);
+    }
+    if (file == NULL) {
+        printf("Error: could not create %s\n", path);
+    } else {
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+        ok = ok && fseek(file, (long) header.types_offset, SEEK_SET) == 0;
+        ok = ok && fwrite(types.names, MAX_STR, types.count, file) == types.count;
+        ok = ok && fseek(file, (long) header.rooms_offset, SEEK_SET) == 0;
+        for (int i = 0; ok && i < building->rooms.size; i++) {
+            ColumnarRoom room;
+            memset(&room, 0, sizeof(room));
+            room.id = building->rooms.elements[i]->id;
+            strcpy(room.name, building->rooms.elements[i]->name);
+            ok = fwrite(&room, sizeof(room), 1, file) == 1;
+        }
+        ok = ok && fseek(file, (long) header.blocks_offset, SEEK_SET) == 0;
+        ok = ok && fwrite(blocks, sizeof(ColumnarBlock), header.block_count, file) == header.block_count;
+
+        // Chunks follow the directory back to back, in the order they were planned
+        for (uint32_t b = 0; ok && b < header.block_count; b++) {
+            for (int c = 0; ok && c < COLUMNAR_COLUMNS; c++) {
+                const ColumnarChunk* plan = &(blocks[b].columns[c]);
+                memset(chunk, 0, plan->size);
+                columnar_pack_chunk(columns[c] + (uint64_t) b * block_rows, blocks[b].rows, plan, chunk);
+                ok = fwrite(chunk, 1, plan->size, file) == plan->size;
+            }
+        }
+        ok = fclose(file) == 0 && ok;
+        if (ok) {
+            result = 0;
+        } else {
+            printf("Error: could not write %s\n", path);
+        }
+    }
+
+    free(chunk);
+    free(blocks);
+    free(types.names);
+    for (int c = 0; c < COLUMNAR_COLUMNS; c++) {
+        free(columns[c]);
+    }
+    return result;
+}
+
+/* Checks that every table and chunk the header describes lies inside the file */
+static bool columnar_validate(const unsigned char* base, size_t size) {
+    if (size < sizeof(ColumnarHeader)) return false;
+    const ColumnarHeader* header = (const ColumnarHeader*) base;
+    if (memcmp(header->magic, COLUMNAR_MAGIC, sizeof(COLUMNAR_MAGIC)) != 0) return false;
+    if (header->version != COLUMNAR_VERSION || header->file_size != size || header->block_rows == 0) return false;
+    if ((uint64_t) header->block_count * header->block_rows < header->row_count) return false;
+
+    if (header->types_offset + (uint64_t) MAX_STR * header->type_count > size) return false;
+    if (header->rooms_offset + sizeof(ColumnarRoom) * (uint64_t) header->room_count > size) return false;
+    if (header->blocks_offset % 8 != 0
+        || header->blocks_offset + sizeof(ColumnarBlock) * (uint64_t) header->block_count > size) return false;
+
+    const ColumnarBlock* blocks = (const ColumnarBlock*) (base + header->blocks_offset);
+    for (uint32_t b = 0; b < header->block_count; b++) {
+        if (blocks[b].rows > header->block_rows) return false;
+        for (int c = 0; c < COLUMNAR_COLUMNS; c++) {
+            const ColumnarChunk* chunk = &(blocks[b].columns[c]);
+            uint64_t needed = ((uint64_t) blocks[b].rows * chunk->bit_width + 7) / 8 + COLUMNAR_PADDING;
+            if (chunk->bit_width > 32 || chunk->size < needed || chunk->offset + chunk->size > size) return false;
+        }
+    }
+    return true;
+}
+
+/*
+  Function: columnar_open
+  Purpose:  Maps a columnar export read-only and checks its structure.
+  Params:
+    out: reader - The reader to initialize.
+    in:  path   - The file to open.
+  Returns:  0 on success, -1 on failure.
+*/
+int columnar_open(ColumnarReader* reader, const char* path) {
+    if (reader == NULL || path == NULL) return -1;
+    reader->base = NULL;
+    reader->size = 0;
+    reader->header = NULL;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(ColumnarHeader)) {
+        close(fd);
+        return -1;
+    }
+    void* addr = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // The mapping keeps the file open
+    if (addr == MAP_FAILED) return -1;
+
+    if (!columnar_validate((const unsigned char*) addr, (size_t) st.st_size)) {
+        printf("Error: %s is not a valid columnar export\n", path);
+        munmap(addr, (size_t) st.st_size);
+        return -1;
+    }
+    reader->base = (const unsigned char*) addr;
+    reader->size = (size_t) st.st_size;
+    reader->header = (const ColumnarHeader*) addr;
+    return 0;
+}
+
+/*
+  Function: columnar_scan
+  Purpose:  Finds every sighting with likelihood at or above a threshold,
+            compared at hundredths precision. Blocks whose maximum is below
+            the threshold are skipped without being decoded, and the other
+            columns are only decoded for blocks with at least one match.
+  Params:
+    in:  reader         - An open reader.
+    in:  min_likelihood - The threshold; 0 matches every row.
+    in:  callback       - Called for each match in file order, or NULL to only count.
+    in:  user           - Passed through to the callback.
+    out: stats          - Block and row counters, or NULL.
+  Returns:  The number of matching sightings.
+*/
+size_t columnar_scan(const ColumnarReader* reader, float min_likelihood, ColumnarRowCallback callback,
+                     void* user, ColumnarScanStats* stats) {
+    ColumnarScanStats counts = { 0, 0, 0 };
+    if (reader == NULL || reader->header == NULL) {
+        if (stats != NULL) *stats = counts;
+        return 0;
+    }
+
+    const ColumnarHeader* header = reader->header;
+    const ColumnarBlock* blocks = (const ColumnarBlock*) (reader->base + header->blocks_offset);
+    const char (*type_names)[MAX_STR] = (const char (*)[MAX_STR]) (reader->base + header->types_offset);
+    const ColumnarRoom* rooms = (const ColumnarRoom*) (reader->base + header->rooms_offset);
+    int32_t threshold = packed_quantize_likelihood(min_likelihood);
+
+    int32_t* values = (int32_t*) malloc(sizeof(int32_t) * header->block_rows * COLUMNAR_COLUMNS);
+    if (values == NULL) {
+        printf("Error: malloc failed in columnar_scan\n");
+        exit(1);
+    }
+    int32_t* columns[COLUMNAR_COLUMNS];
+    for (int c = 0; c < COLUMNAR_COLUMNS; c++) {
+        columns[c] = values + (size_t) c * header->block_rows;
+    }
+
+    for (uint32_t b = 0; b < header->block_count; b++) {
+        const ColumnarBlock* block = &(blocks[b]);
+        if (block->columns[COLUMNAR_LIKELIHOOD].max < threshold) {
+            counts.blocks_skipped++;
+            continue;
+        }
+        counts.blocks_scanned++;
+
+        columnar_unpack_chunk(reader->base, &(block->columns[COLUMNAR_LIKELIHOOD]), block->rows,
+                              columns[COLUMNAR_LIKELIHOOD]);
+        if (callback == NULL) {
+            for (uint32_t i = 0; i < block->rows; i++) {
+                if (columns[COLUMNAR_LIKELIHOOD][i] >= threshold) counts.rows_matched++;
+            }
+            continue;
+        }
+
+        for (int c = 0; c < COLUMNAR_LIKELIHOOD; c++) {
+            columnar_unpack_chunk(reader->base, &(block->columns[c]), block->rows, columns[c]);
+        }
+        for (uint32_t i = 0; i < block->rows; i++) {
+            if (columns[COLUMNAR_LIKELIHOOD][i] < threshold) continue;
+
+            ColumnarRow out;
+            out.id = columns[COLUMNAR_ID][i];
+            uint32_t type = (uint32_t) columns[COLUMNAR_TYPE][i];
+            out.type = type < header->type_count ? type_names[type] : "";
+            out.room_id = columns[COLUMNAR_ROOM][i];
+            out.room_name = "";
+            for (uint32_t r = 0; r < header->room_count; r++) {
+                if (rooms[r].id == out.room_id) {
+                    out.room_name = rooms[r].name;
+                    break;
+                }
+            }
+            out.likelihood = packed_dequantize_likelihood((uint16_t) columns[COLUMNAR_LIKELIHOOD][i]);
+            counts.rows_matched++;
+            callback(&out, user);
+        }
+    }
+
+    free(values);
+    if (stats != NULL) *stats = counts;
+    return counts.rows_matched;
+}
+
+/*
+  Function: columnar_close
+  Purpose:  Unmaps a reader's file.
+  Params:
+    in/out: reader - The reader to close.
+*/
+void columnar_close(ColumnarReader* reader) {
+    if (reader == NULL || reader->base == NULL) return;
+    munmap((void*) reader->base, reader->size);
+    reader->base = NULL;
+    reader->size = 0;
+    reader->header = NULL;
+}
@@ -0,0 +1,479 @@
+#define _GNU_SOURCE // accept4
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "defs.h"
+
+/* This file contains the resident tracker daemon: a single-threaded epoll
+   loop that keeps one Building in memory and answers framed binary requests
+   over a UNIX domain socket. */
+
+// Per-connection state, stored in the epoll event's data pointer
+typedef struct DaemonClient DaemonClient;
+struct DaemonClient {
+    int fd;
+    uint32_t events; // Current epoll interest
+    DaemonBuffer in;
+    DaemonBuffer out;
+    DaemonClient* prev;
+    DaemonClient* next;
+};
+
+static volatile sig_atomic_t daemon_stop = 0;
+
+static void daemon_handle_signal(int sig) {
+    (void) sig;
+    daemon_stop = 1;
+}
+
+/*
+  Function: daemonbuffer_init
+  Purpose:  Initializes a DaemonBuffer to an empty state.
+  Params:
+    out: buffer - The buffer to initialize.
+*/
+void daemonbuffer_init(DaemonBuffer* buffer) {
+    if (buffer == NULL) return;
+    buffer->data = NULL;
+    buffer->len = 0;
+    buffer->cap = 0;
+}
+
+/*
+  Function: daemonbuffer_append
+  Purpose:  Appends bytes to the end of the buffer, growing it as needed.
+  Params:
+    in/out: buffer - The buffer to append to.
+    in:     data   - The bytes to append.
+    in:     len    - The number of bytes to append.
+*/
+void daemonbuffer_append(DaemonBuffer* buffer, const void* data, size_t len) {
+    if (buffer == NULL || len == 0) return;
+
+    if (buffer->len + len > buffer->cap) {
+        size_t cap = buffer->cap == 0 ? DAEMON_READ_CHUNK : buffer->cap;
+        while (cap < buffer->len + len) {
+            cap *= 2;
+        }
+        unsigned char* grown = (unsigned char*) realloc(buffer->data, cap);
+        if (grown == NULL) {
+            printf("Error: realloc failed in daemonbuffer_append\n");
+            exit(1);
+        }
+        buffer->data = grown;
+        buffer->cap = cap;
+    }
+    memcpy(buffer->data + buffer->len, data, len);
+    buffer->len += len;
+}
+
+/*
+  Function: daemonbuffer_consume
+  Purpose:  Drops bytes from the front of the buffer.
+  Params:
+    in/out: buffer - The buffer to consume from.
+    in:     len    - The number of bytes to drop.
+*/
+void daemonbuffer_consume(DaemonBuffer* buffer, size_t len) {
+    if (buffer == NULL) return;
+
+    if (len >= buffer->len) {
+        buffer->len = 0;
+        return;
+    }
+    memmove(buffer->data, buffer->data + len, buffer->len - len);
+    buffer->len -= len;
+}
+
+/*
+  Function: daemonbuffer_cleanup
+  Purpose:  Frees the storage owned by a DaemonBuffer.
+  Params:
+    in/out: buffer - The buffer to clean up.
+*/
+void daemonbuffer_cleanup(DaemonBuffer* buffer) {
+    if (buffer == NULL) return;
+    free(buffer->data);
+    daemonbuffer_init(buffer);
+}
+
+/* Copies a ghost into the fixed-size wire record */
+static void daemon_record_from_ghost(DaemonRecord* record, const Ghost* ghost) {
+    memset(record, 0, sizeof(DaemonRecord));
+    record->id = ghost->id;
+    record->room_id = ghost->room == NULL ? -1 : ghost->room->id;
+    record->likelihood = ghost->likelihood;
+    strcpy(record->type, ghost->type);
+}
+
+/* Writes a response header into `out` and returns its offset so the record
+   count can be patched once the records have been appended */
+static size_t daemon_begin_response(DaemonBuffer* out, uint8_t op, uint8_t status) {
+    DaemonResponseHeader header = { op, status, 0, 0 };
+    size_t offset = out->len;
+    daemonbuffer_append(out, &header, sizeof(header));
+    return offset;
+}
+
+static void daemon_append_record(DaemonBuffer* out, size_t header_offset, const Ghost* ghost) {
+    DaemonRecord record;
+    daemon_record_from_ghost(&record, ghost);
+    daemonbuffer_append(out, &record, sizeof(record));
+
+    DaemonResponseHeader* header = (DaemonResponseHeader*) (out->data + header_offset);
+    header->count++;
+}
+
+/* Copies a wire string into a NUL-terminated MAX_STR buffer */
+static void daemon_copy_type(char* dest, const char* src) {
+    memcpy(dest, src, MAX_STR);
+    dest[MAX_STR - 1] = '\0';
+}
+
+static void daemon_top_k(Building* building, uint32_t k, DaemonBuffer* out) {
+    size_t header = daemon_begin_response(out, DAEMON_OP_TOP_K, DAEMON_OK);
+    if (k == 0) return;
+
+    // Never allocate more slots than there are ghosts
+    uint32_t total = 0;
+    for (GhostNode* curr = building->ghosts.head; curr != NULL && total < k; curr = curr->next) {
+        total++;
+    }
+    if (total == 0) return;
+    k = total;
+
+    // Keep the best k ghosts seen so far in descending order (insertion into a small array)
+    Ghost** best = (Ghost**) malloc(sizeof(Ghost*) * k);
+    if (best == NULL) {
+        printf("Error: malloc failed in daemon_top_k\n");
+        exit(1);
+    }
+    uint32_t count = 0;
+
+    for (GhostNode* curr = building->ghosts.head; curr != NULL; curr = curr->next) {
+        Ghost* ghost = curr->data;
+        if (count == k && ghost->likelihood <= best[k - 1]->likelihood) continue;
+
+        uint32_t pos = count < k ? count++ : k - 1;
+        while (pos > 0 && best[pos - 1]->likelihood < ghost->likelihood) {
+            best[pos] = best[pos - 1];
+            pos--;
+        }
+        best[pos] = ghost;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        daemon_append_record(out, header, best[i]);
+    }
+    free(best);
+}
+
+/* Executes a single request and appends its response frame to `out` */
+static void daemon_handle_request(Building* building, const DaemonRequestHeader* request,
+                                  const unsigned char* payload, DaemonBuffer* out) {
+    switch (request->op) {
+        case DAEMON_OP_ADD_SIGHTING: {
+            DaemonSightingRequest sighting;
+            if (request->length != sizeof(sighting)) break;
+            memcpy(&sighting, payload, sizeof(sighting));
+            // Same bounds as the ingest pipeline; NaN fails both comparisons
+            if (!(sighting.likelihood >= 0.0f && sighting.likelihood <= 100.0f)) break;
+
+            Room* room = roomarray_find(&building->rooms, sighting.room_id);
+            if (room == NULL) {
+                daemon_begin_response(out, request->op, DAEMON_ERR_NO_ROOM);
+                return;
+            }
+            char type[MAX_STR];
+            daemon_copy_type(type, sighting.type);
+            // Repeat reports of a type in a room update the existing ghost
+            Ghost* ghost = building_upsert_ghost(building, type, room, sighting.likelihood);
+
+            size_t header = daemon_begin_response(out, request->op, DAEMON_OK);
+            daemon_append_record(out, header, ghost);
+            return;
+        }
+        case DAEMON_OP_ROOM_LIST: {
+            int32_t room_id;
+            if (request->length != sizeof(room_id)) break;
+            memcpy(&room_id, payload, sizeof(room_id));
+
+            Room* room = roomarray_find(&building->rooms, room_id);
+            if (room == NULL) {
+                daemon_begin_response(out, request->op, DAEMON_ERR_NO_ROOM);
+                return;
+            }
+            room_flush(room); // The daemon thread is the building's only writer
+            size_t header = daemon_begin_response(out, request->op, DAEMON_OK);
+            for (GhostNode* curr = room->ghosts.head; curr != NULL; curr = curr->next) {
+                daemon_append_record(out, header, curr->data);
+            }
+            return;
+        }
+        case DAEMON_OP_TOP_K: {
+            uint32_t k;
+            if (request->length != sizeof(k)) break;
+            memcpy(&k, payload, sizeof(k));
+            daemon_top_k(building, k, out);
+            return;
+        }
+        case DAEMON_OP_BY_TYPE: {
+            char type[MAX_STR];
+            if (request->length != MAX_STR) break;
+            daemon_copy_type(type, (const char*) payload);
+
+            size_t header = daemon_begin_response(out, request->op, DAEMON_OK);
+            for (GhostNode* curr = building->ghosts.head; curr != NULL; curr = curr->next) {
+                if (strcmp(curr->data->type, type) == 0) {
+                    daemon_append_record(out, header, curr->data);
+                }
+            }
+            return;
+        }
+    }
+
+    // Unknown opcode, payload of the wrong size or likelihood outside 0 to 100
+    daemon_begin_response(out, request->op, DAEMON_ERR_BAD_REQUEST);
+}
+
+/*
+  Function: daemon_process_frames
+  Purpose:  Executes every complete request frame in `data`, appending all
+            responses to `out` so they can be flushed with a single write.
+            Stops early once `out` passes DAEMON_OUTBUF_HIGH_WATER.
+  Params:
+    in/out: building - The building the requests operate on.
+    in:     data     - Buffered request bytes, possibly ending in a partial frame.
+    in:     len      - The number of buffered bytes.
+    in/out: out      - The buffer that receives the response frames.
+  Returns:  The number of bytes consumed from `data`.
+*/
+size_t daemon_process_frames(Building* building, const unsigned char* data, size_t len, DaemonBuffer* out) {
+    size_t offset = 0;
+
+    while (len - offset >= sizeof(DaemonRequestHeader) && out->len < DAEMON_OUTBUF_HIGH_WATER) {
+        DaemonRequestHeader request;
+        memcpy(&request, data + offset, sizeof(request));
+
+        size_t frame = sizeof(request) + request.length;
+        if (len - offset < frame) break; // Wait for the rest of the payload
+
+        daemon_handle_request(building, &request, data + offset + sizeof(request), out);
+        offset += frame;
+    }
+    return offset;
+}
+
+static void daemon_client_close(int epfd, DaemonClient** clients, DaemonClient* client) {
+    // Unlink from the list of open clients
+    if (client->prev != NULL) client->prev->next = client->next;
+    else *clients = client->next;
+    if (client->next != NULL) client->next->prev = client->prev;
+
+    epoll_ctl(epfd, EPOLL_CTL_DEL, client->fd, NULL);
+    close(client->fd);
+    daemonbuffer_cleanup(&client->in);
+    daemonbuffer_cleanup(&client->out);
+    free(client);
+}
+
+/* Flushes as much of the output buffer as the socket accepts, then updates
+   epoll interest: EPOLLOUT while output is pending, and EPOLLIN only while
+   both buffers have room, so a client that never reads stops being read.
+   Returns false if the client must be closed. */
+static bool daemon_client_flush(int epfd, DaemonClient* client) {
+    while (client->out.len > 0) {
+        ssize_t n = send(client->fd, client->out.data, client->out.len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return false;
+        }
+        daemonbuffer_consume(&client->out, (size_t) n);
+    }
+
+    uint32_t events = 0;
+    if (client->out.len < DAEMON_OUTBUF_HIGH_WATER && client->in.len < DAEMON_INBUF_MAX) events |= EPOLLIN;
+    if (client->out.len > 0) events |= EPOLLOUT;
+    if (events != client->events) {
+        struct epoll_event ev;
+        ev.events = events;
+        ev.data.ptr = client;
+        if (epoll_ctl(epfd, EPOLL_CTL_MOD, client->fd, &ev) < 0) return false;
+        client->events = events;
+    }
+    return true;
+}
+
+/* Runs every buffered request, then flushes the batched responses */
+static bool daemon_client_service(int epfd, Building* building, DaemonClient* client) {
+    for (;;) {
+        bool had_room = client->out.len < DAEMON_OUTBUF_HIGH_WATER;
+        size_t used = daemon_process_frames(building, client->in.data, client->in.len, &client->out);
+        daemonbuffer_consume(&client->in, used);
+        if (!daemon_client_flush(epfd, client)) return false;
+
+        /* Processing stops at the output high-water mark. If the socket then
+           took enough of it, run the frames still buffered now: no further
+           event may arrive for them once EPOLLOUT is dropped. */
+        if (client->out.len >= DAEMON_OUTBUF_HIGH_WATER) return true; // EPOLLOUT calls back
+        if (had_room && used == 0) return true; // No complete frame left
+    }
+}
+
+/* Reads from the socket into the input buffer until it would block or the
+   buffer reaches DAEMON_INBUF_MAX. Returns false on EOF or error. */
+static bool daemon_client_read(DaemonClient* client) {
+    unsigned char chunk[DAEMON_READ_CHUNK];
+
+    while (client->in.len < DAEMON_INBUF_MAX) {
+        size_t room = DAEMON_INBUF_MAX - client->in.len;
+        ssize_t n = recv(client->fd, chunk, room < sizeof(chunk) ? room : sizeof(chunk), 0);
+        if (n > 0) {
+            daemonbuffer_append(&client->in, chunk, (size_t) n);
+            continue;
+        }
+        if (n == 0) return false;
+        if (errno == EINTR) continue;
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    return true; // The rest stays in the socket until the buffer drains
+}
+
+static void daemon_accept(int epfd, int listen_fd, DaemonClient** clients) {
+    for (;;) {
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return; // EAGAIN once the backlog is drained
+
+        DaemonClient* client = (DaemonClient*) malloc(sizeof(DaemonClient));
+        if (client == NULL) {
+            printf("Error: malloc failed in daemon_accept\n");
+            exit(1);
+        }
+        client->fd = fd;
+        client->events = EPOLLIN;
+        daemonbuffer_init(&client->in);
+        daemonbuffer_init(&client->out);
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = client;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            close(fd);
+            free(client);
+            continue;
+        }
+
+        client->prev = NULL;
+        client->next = *clients;
+        if (*clients != NULL) (*clients)->prev = client;
+        *clients = client;
+    }
+}
+
+/*
+  Function: daemon_run
+  Purpose:  Serves requests against the building over a UNIX domain socket
+            until SIGINT or SIGTERM is received. Every readable client has all
+            of its pipelined frames executed and the responses written back
+            in one batch.
+  Params:
+    in/out: building    - The building kept resident for the daemon's lifetime.
+    in:     socket_path - Filesystem path of the listening socket.
+  Returns:  0 on clean shutdown, -1 if the socket could not be set up.
+*/
+int daemon_run(Building* building, const char* socket_path) {
+    if (building == NULL || socket_path == NULL) return -1;
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        printf("Error: socket path too long: %s\n", socket_path);
+        return -1;
+    }
+    strcpy(addr.sun_path, socket_path);
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        printf("Error: socket failed in daemon_run (%s)\n", strerror(errno));
+        return -1;
+    }
+    unlink(socket_path);
+    if (bind(listen_fd, (struct sockaddr*) &addr, sizeof(addr)) < 0 || listen(listen_fd, SOMAXCONN) < 0) {
+        printf("Error: could not listen on %s (%s)\n", socket_path, strerror(errno));
+        close(listen_fd);
+        return -1;
+    }
+
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL; // NULL marks the listening socket
+    if (epfd < 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, listen_fd, &ev) < 0) {
+        printf("Error: epoll setup failed in daemon_run (%s)\n", strerror(errno));
+        if (epfd >= 0) close(epfd);
+        close(listen_fd);
+        unlink(socket_path);
+        return -1;
+    }
+
+    // No SA_RESTART, so a signal interrupts epoll_wait and ends the loop
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = daemon_handle_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    daemon_stop = 0;
+
+    printf("Daemon listening on %s\n", socket_path);
+    fflush(stdout);
+
+    DaemonClient* clients = NULL;
+    struct epoll_event events[DAEMON_MAX_EVENTS];
+    while (!daemon_stop) {
+        int n = epoll_wait(epfd, events, DAEMON_MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            printf("Error: epoll_wait failed (%s)\n", strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            DaemonClient* client = (DaemonClient*) events[i].data.ptr;
+            if (client == NULL) {
+                daemon_accept(epfd, listen_fd, &clients);
+                continue;
+            }
+
+            bool alive = true;
+            if (events[i].events & EPOLLIN) {
+                alive = daemon_client_read(client);
+            }
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                alive = false;
+            }
+            // Answer whatever arrived even if the peer already half-closed
+            if (!daemon_client_service(epfd, building, client) || !alive) {
+                daemon_client_close(epfd, &clients, client);
+            }
+        }
+    }
+
+    while (clients != NULL) {
+        daemon_client_close(epfd, &clients, clients);
+    }
+    close(epfd);
+    close(listen_fd);
+    unlink(socket_path);
+    printf("Daemon stopped.\n");
+    return 0;
+}
@@ -1,8 +1,57 @@
+#include <pthread.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
 
 #define MAX_STR 32
 #define MAX_ROOMS 16
 #define GHOST_INITIAL_ID 1031
+#define GHOST_INDEX_INITIAL_CAPACITY 64
+
+// Tracker daemon limits
+#define DAEMON_MAX_EVENTS 64
+#define DAEMON_READ_CHUNK 4096
+#define DAEMON_OUTBUF_HIGH_WATER (1 << 20)
+#define DAEMON_INBUF_MAX (1 << 20) // Must hold the largest frame (4 + 65535 bytes)
+
+// Shared-memory replica limits
+#define REPLICA_MAGIC 0x47485250u // "GHRP"
+#define REPLICA_NAME_MAX 64
+#define REPLICA_OPEN_RETRIES 8
+
+// Epoch-based reclamation limits
+#define EPOCH_MAX_READERS 64
+#define EPOCH_CACHE_LINE 64
+
+// Packed sighting records
+#define PACKED_BLOCK_SIZE 16
+#define PACKED_MAX_TYPES 256
+#define PACKED_NO_ROOM 0xFF
+#define PACKED_MAX_DELTA 0xFF
+#define PACKED_LIKELIHOOD_SCALE 100 // Hundredths of a percent
+
+// Ingest pipeline limits
+#define PIPELINE_RING_CAPACITY 1024 // Power of two
+#define PIPELINE_MAX_INSERTERS 8
+#define PIPELINE_LINE_MAX 128
+
+// Subscription limits
+#define SUBSCRIPTION_ANY_ROOM -1
+#define SUBSCRIPTION_BUCKETS 64 // Power of two
+#define SUBSCRIPTION_QUEUE_CAPACITY 1024
+
+// Columnar export format
+#define COLUMNAR_MAGIC "GHCOL01"
+#define COLUMNAR_VERSION 1
+#define COLUMNAR_BLOCK_ROWS 4096
+#define COLUMNAR_PADDING 8 // Slack after each chunk so unpacking can read 8 bytes at once
+
+// Ghost id allocator
+#define IDSPACE_MAX_SPACES 16
+#define IDSPACE_DEFAULT_BLOCK 64
+#define IDSPACE_RESERVE_BLOCKS 16 // Blocks covered by each persisted high-water mark
+#define IDSPACE_PATH_MAX 256
 
 // Type definitions
 typedef struct Ghost Ghost;
@@ -11,6 +60,39 @@ typedef struct GhostList GhostList;
 typedef struct Room Room;
 typedef struct RoomArray RoomArray;
 typedef struct Building Building;
+typedef struct GhostIndexEntry GhostIndexEntry;
+typedef struct GhostIndex GhostIndex;
+typedef struct DaemonRequestHeader DaemonRequestHeader;
+typedef struct DaemonResponseHeader DaemonResponseHeader;
+typedef struct DaemonSightingRequest DaemonSightingRequest;
+typedef struct DaemonRecord DaemonRecord;
+typedef struct DaemonBuffer DaemonBuffer;
+typedef struct ReplicaControl ReplicaControl;
+typedef struct ReplicaHeader ReplicaHeader;
+typedef struct ReplicaRoom ReplicaRoom;
+typedef struct ReplicaGhost ReplicaGhost;
+typedef struct ReplicaPublisher ReplicaPublisher;
+typedef struct ReplicaReader ReplicaReader;
+typedef struct EpochReader EpochReader;
+typedef struct PackedBlock PackedBlock;
+typedef struct PackedStore PackedStore;
+typedef struct RingBuffer RingBuffer;
+typedef struct PipelineStageStats PipelineStageStats;
+typedef struct PipelineStats PipelineStats;
+typedef struct AlertEvent AlertEvent;
+typedef struct Subscription Subscription;
+typedef void (*AlertCallback)(const AlertEvent* event, void* user);
+typedef struct SubscriptionBucket SubscriptionBucket;
+typedef struct SubscriptionRegistry SubscriptionRegistry;
+typedef struct IdSpace IdSpace;
+typedef struct ColumnarHeader ColumnarHeader;
+typedef struct ColumnarRoom ColumnarRoom;
+typedef struct ColumnarChunk ColumnarChunk;
+typedef struct ColumnarBlock ColumnarBlock;
+typedef struct ColumnarReader ColumnarReader;
+typedef struct ColumnarRow ColumnarRow;
+typedef struct ColumnarScanStats ColumnarScanStats;
+typedef void (*ColumnarRowCallback)(const ColumnarRow* row, void* user);
 
 // Structure for a single Ghost
 struct Ghost {
@@ -26,6 +108,10 @@ struct GhostNode {
     GhostNode* next;
 };
 
+/* Lists may be traversed by epoch readers while a writer modifies them, so
+   writers publish links with release stores and readers follow them with
+   acquire loads (see ghostlist_read_head / ghostnode_read_next). */
+
 // Singly-linked list for Ghosts
 struct GhostList {
     GhostNode* head;
@@ -37,6 +123,10 @@ struct Room {
     int id;
     char name[MAX_STR];
     GhostList ghosts;
+    GhostList pending; // Unsorted appends while deferred, merged by room_flush or the next print
+    bool deferred;     // Append now, sort on flush or the next print
+    bool dirty;        // pending holds ghosts not yet merged into ghosts
+    SubscriptionRegistry* subscriptions; // The owning building's, set by building_add_room
 };
 
 // Fixed-size array structure for Rooms
@@ -45,15 +135,330 @@ struct RoomArray {
     int size;
 };
 
+// How a repeat report of the same (type, room) is merged into the existing ghost
+enum MergePolicy { MERGE_MAX, MERGE_LATEST, MERGE_AVERAGE };
+
+// Slot in the (type, room id) hash index; ghost is NULL when empty
+struct GhostIndexEntry {
+    Ghost* ghost;
+    int room_id;
+    unsigned int hash;
+    int reports;  // Reports merged into this ghost, for MERGE_AVERAGE
+    bool deleted; // Tombstone left by ghostindex_remove
+};
+
+// Open-addressing hash index from (type, room id) to the ghost
+struct GhostIndex {
+    GhostIndexEntry* entries;
+    int capacity;
+    int count;
+    int tombstones;
+};
+
+// Subscriptions for one (room id, type) hash, sorted by min_likelihood ascending
+struct SubscriptionBucket {
+    Subscription** items;
+    int size;
+    int cap;
+};
+
+// A building's subscriptions plus the queue for alerts without a callback
+struct SubscriptionRegistry {
+    SubscriptionBucket buckets[SUBSCRIPTION_BUCKETS];
+    int count; // Read without the lock as a fast path
+    int next_id;
+    pthread_rwlock_t lock;
+    AlertEvent* queue; // SUBSCRIPTION_QUEUE_CAPACITY slots; oldest dropped when full
+    size_t queue_head;
+    size_t queue_size;
+    size_t dropped;
+    pthread_mutex_t queue_lock;
+};
+
 // Main building structure
 struct Building {
     struct RoomArray rooms;
     struct GhostList ghosts;
+    struct GhostIndex index;
+    enum MergePolicy merge_policy;
+    int deduplicated; // Upserts merged into an existing ghost
+    struct SubscriptionRegistry subscriptions;
+};
+
+// Request opcodes understood by the tracker daemon
+enum DaemonOp {
+    DAEMON_OP_ADD_SIGHTING = 1, // payload: DaemonSightingRequest
+    DAEMON_OP_ROOM_LIST,        // payload: int32_t room id
+    DAEMON_OP_TOP_K,            // payload: uint32_t k
+    DAEMON_OP_BY_TYPE           // payload: char type[MAX_STR]
+};
+
+// Status codes returned in DaemonResponseHeader.status
+enum DaemonStatus { DAEMON_OK = 0, DAEMON_ERR_BAD_REQUEST, DAEMON_ERR_NO_ROOM };
+
+// Every request frame starts with this header, followed by `length` payload bytes
+struct DaemonRequestHeader {
+    uint8_t op;
+    uint8_t reserved;
+    uint16_t length;
+};
+
+// Every response frame starts with this header, followed by `count` DaemonRecords
+struct DaemonResponseHeader {
+    uint8_t op;
+    uint8_t status;
+    uint16_t reserved;
+    uint32_t count;
+};
+
+// Payload of a DAEMON_OP_ADD_SIGHTING request
+struct DaemonSightingRequest {
+    int32_t room_id;
+    float likelihood;
+    char type[MAX_STR];
+};
+
+// Fixed-size ghost record sent back to clients
+struct DaemonRecord {
+    int32_t id;
+    int32_t room_id;
+    float likelihood;
+    char type[MAX_STR];
+};
+
+// Growable byte buffer used for per-client input and batched output
+struct DaemonBuffer {
+    unsigned char* data;
+    size_t len;
+    size_t cap;
+};
+
+/* Shared-memory replica layout. Records refer to each other by array index and
+   sections are located by byte offsets from the start of the segment, so a
+   segment can be mapped at any address in any process. */
+
+// Small control segment whose epoch names the current data segment
+struct ReplicaControl {
+    uint32_t magic;
+    uint32_t reserved;
+    uint64_t epoch;
+};
+
+// Start of every data segment
+struct ReplicaHeader {
+    uint32_t magic;
+    uint32_t room_count;
+    uint32_t ghost_count;
+    uint32_t reserved;
+    uint64_t epoch;
+    uint64_t rooms_offset;       // ReplicaRoom[room_count]
+    uint64_t ghosts_offset;      // ReplicaGhost[ghost_count], building list order
+    uint64_t room_ghosts_offset; // uint32_t ghost indices, each room's run sorted by likelihood
+    uint64_t size;
+};
+
+struct ReplicaRoom {
+    int32_t id;
+    char name[MAX_STR];
+    uint32_t ghost_first; // First entry in the room_ghosts section
+    uint32_t ghost_count;
+};
+
+struct ReplicaGhost {
+    int32_t id;
+    int32_t room_index; // Index into the rooms section, -1 if none
+    float likelihood;
+    char type[MAX_STR];
+};
+
+// Writer side: owns the control segment and the current data segment
+struct ReplicaPublisher {
+    char name[REPLICA_NAME_MAX];
+    ReplicaControl* control;
+    uint64_t epoch;
+};
+
+// Reader side: read-only mappings of the control and current data segments
+struct ReplicaReader {
+    char name[REPLICA_NAME_MAX];
+    const ReplicaControl* control;
+    const ReplicaHeader* header;
+};
+
+// Per-thread reader slot. state is 0 when idle, (epoch << 1) | 1 inside a read section.
+struct EpochReader {
+    uint64_t state;
+    bool in_use;
+    char padding[EPOCH_CACHE_LINE - sizeof(uint64_t) - sizeof(bool)];
+} __attribute__((aligned(EPOCH_CACHE_LINE)));
+
+/* A block of up to PACKED_BLOCK_SIZE sightings stored column-wise. Ids are
+   deltas from the previous id in the block; type and room are small indices. */
+struct PackedBlock {
+    int32_t base_id;                              // Id of the first sighting
+    int32_t first_index;                          // Store position of the first sighting
+    uint8_t count;
+    uint8_t id_delta[PACKED_BLOCK_SIZE];          // id - previous id, 0 for the first
+    uint8_t type[PACKED_BLOCK_SIZE];              // Index into PackedStore.types
+    uint8_t room[PACKED_BLOCK_SIZE];              // Index into the RoomArray, or PACKED_NO_ROOM
+    uint16_t likelihood[PACKED_BLOCK_SIZE];       // Fixed point, hundredths of a percent
+};
+
+// Compact archive of sightings, decoded back into Ghost values on read
+struct PackedStore {
+    const RoomArray* rooms;
+    char types[PACKED_MAX_TYPES][MAX_STR];
+    int type_count;
+    PackedBlock* blocks;
+    int block_count;
+    int block_cap;
+    int size;
+};
+
+/* Bounded single-producer/single-consumer ring of fixed-size items. The
+   producer only writes tail and the consumer only writes head, each on its
+   own cache line. */
+struct RingBuffer {
+    size_t head __attribute__((aligned(EPOCH_CACHE_LINE)));  // Next slot to pop
+    size_t tail __attribute__((aligned(EPOCH_CACHE_LINE)));  // Next slot to push
+    bool closed;                                              // Producer is done
+    size_t capacity __attribute__((aligned(EPOCH_CACHE_LINE)));
+    size_t item_size;
+    unsigned char* slots;
+    size_t max_depth;    // Deepest the queue got, sampled by the producer
+    size_t full_stalls;  // Pushes that had to wait for space
+};
+
+// Stages of the ingest pipeline, in order
+enum PipelineStage { PIPELINE_PARSE, PIPELINE_VALIDATE, PIPELINE_ROUTE, PIPELINE_INSERT, PIPELINE_STAGES };
+
+// Counters for one stage (the insert stage sums its inserter threads)
+struct PipelineStageStats {
+    size_t processed;      // Items the stage handled
+    size_t rejected;       // Items the stage dropped
+    size_t full_stalls;    // Times the stage waited on a full output queue
+    size_t max_queue_depth; // Deepest its output queue got
+    double seconds;        // Time the stage thread ran
+};
+
+struct PipelineStats {
+    PipelineStageStats stages[PIPELINE_STAGES];
+    int inserters;
+    double seconds;
+};
+
+// A sighting that matched a subscription
+struct AlertEvent {
+    int subscription_id;
+    int ghost_id;
+    int room_id;
+    float likelihood;
+    bool new_head;
+    char type[MAX_STR];
+};
+
+// Predicate registered by a client; every set field must match
+struct Subscription {
+    int id;
+    char type[MAX_STR];   // Empty string matches any type
+    unsigned int type_hash;
+    int room_id;          // SUBSCRIPTION_ANY_ROOM matches any room
+    float min_likelihood;
+    bool new_head_only;   // Only fire when the ghost becomes its room's head
+    AlertCallback callback; // NULL delivers to the alert queue instead
+    void* user;
+};
+
+/* An independent sequence of ids. Threads take ids from private blocks of
+   block_size and only lock the space to fetch a new block. */
+struct IdSpace {
+    int slot;            // Index into each thread's block cache
+    uint64_t generation; // Tells this space apart from earlier users of the slot
+    int block_size;
+    int next;            // First id not yet given to any thread
+    int high_water;      // Persisted limit; a restart resumes here
+    char path[IDSPACE_PATH_MAX]; // Empty for a space that is not persisted
+    int lock_fd;         // Holds the flock on <path>.lock, -1 if not persisted
+    pthread_mutex_t lock;
+};
+
+/* Columnar export file layout: header, type dictionary, room table, block
+   directory, then the encoded column chunks. All offsets are from the start
+   of the file. */
+
+// Columns stored for every sighting
+enum ColumnarColumn { COLUMNAR_ID, COLUMNAR_TYPE, COLUMNAR_ROOM, COLUMNAR_LIKELIHOOD, COLUMNAR_COLUMNS };
+
+// How a chunk's values are stored; both are bit-packed at bit_width bits per value
+enum ColumnarEncoding {
+    COLUMNAR_FOR,  // value - base (frame of reference); dictionary indices use this too
+    COLUMNAR_DELTA // zigzag(value - previous value), previous starts at base
+};
+
+struct ColumnarHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t block_rows;
+    uint64_t row_count;
+    uint32_t block_count;
+    uint32_t type_count;
+    uint32_t room_count;
+    uint32_t reserved;
+    uint64_t types_offset;  // char[type_count][MAX_STR]
+    uint64_t rooms_offset;  // ColumnarRoom[room_count]
+    uint64_t blocks_offset; // ColumnarBlock[block_count]
+    uint64_t file_size;
+};
+
+struct ColumnarRoom {
+    int32_t id;
+    char name[MAX_STR];
+};
+
+// One column of one block, with the stats used to skip it
+struct ColumnarChunk {
+    uint64_t offset;
+    uint32_t size;
+    uint8_t encoding;
+    uint8_t bit_width;
+    uint16_t reserved;
+    int32_t base;
+    int32_t min;
+    int32_t max;
+};
+
+struct ColumnarBlock {
+    uint32_t rows;
+    uint32_t reserved;
+    ColumnarChunk columns[COLUMNAR_COLUMNS];
+};
+
+// Read-only mapping of an export file
+struct ColumnarReader {
+    const unsigned char* base;
+    size_t size;
+    const ColumnarHeader* header;
+};
+
+// One decoded sighting handed to a scan callback
+struct ColumnarRow {
+    int id;
+    const char* type;
+    int room_id;
+    const char* room_name;
+    float likelihood;
+};
+
+struct ColumnarScanStats {
+    size_t blocks_scanned;
+    size_t blocks_skipped;
+    size_t rows_matched;
 };
 
 
 // Ghost Functions
 void ghost_create(Ghost** ghost, const char* type);
+void ghost_set_id_space(IdSpace* space);
 void ghost_print(const Ghost* ghost);
 void ghost_cleanup(Ghost** ghost);
 
@@ -64,22 +469,131 @@ void ghostlist_print(const GhostList* list);
 void ghostlist_cleanup(GhostList* list, bool free_data);
 // Helper function for sorted insertion, required by room_add_ghost
 void ghostlist_insert_by_likelihood(GhostList* list, Ghost* ghost);
+bool ghostlist_remove(GhostList* list, const Ghost* ghost);
+
+// Lock-free traversal helpers for epoch readers
+static inline GhostNode* ghostlist_read_head(const GhostList* list) {
+    return __atomic_load_n(&list->head, __ATOMIC_ACQUIRE);
+}
+static inline GhostNode* ghostnode_read_next(const GhostNode* node) {
+    return __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+}
 
 // Room Functions
 void room_create(Room** room, int id, const char* name);
 void room_add_ghost(Room* room, Ghost* ghost, float likelihood);
-void room_print(const Room* room);
+bool room_reposition_ghost(Room* room, Ghost* ghost, float likelihood);
+void room_print(Room* room);
+void room_set_deferred(Room* room, bool deferred);
+void room_flush(Room* room);
+bool room_remove_ghost(Room* room, const Ghost* ghost);
 void room_cleanup(Room** room);
 
 // RoomArray Functions
 void roomarray_init(RoomArray* array);
 void roomarray_add(RoomArray* array, Room* room);
-void roomarray_print(const RoomArray* array);
+void roomarray_print(RoomArray* array);
+Room* roomarray_find(const RoomArray* array, int id);
 void roomarray_cleanup(RoomArray* array);
 
 // Building Functions
 void building_init(Building* building);
 void building_cleanup(Building* building);
+bool building_remove_ghost(Building* building, Ghost* ghost);
+Ghost* building_upsert_ghost(Building* building, const char* type, Room* room, float likelihood);
+void building_merge_report(const Building* building, Ghost* ghost, float likelihood, int reports);
+
+// GhostIndex Functions
+void ghostindex_init(GhostIndex* index);
+GhostIndexEntry* ghostindex_find(const GhostIndex* index, const char* type, int room_id);
+GhostIndexEntry* ghostindex_insert(GhostIndex* index, Ghost* ghost, int room_id);
+bool ghostindex_remove(GhostIndex* index, const Ghost* ghost, int room_id);
+void ghostindex_cleanup(GhostIndex* index);
 
 // Sample Data Loading Function (provided)
-void building_load_sample(Building* building);
\ No newline at end of file
+void building_load_sample(Building* building);
+void building_add_room(Building* building, Room* room);
+void building_flush(Building* building);
+void util_ghost_create_and_add(Building* building, const char* type, Room* room, float likelihood);
+
+// Daemon Functions
+void daemonbuffer_init(DaemonBuffer* buffer);
+void daemonbuffer_append(DaemonBuffer* buffer, const void* data, size_t len);
+void daemonbuffer_consume(DaemonBuffer* buffer, size_t len);
+void daemonbuffer_cleanup(DaemonBuffer* buffer);
+size_t daemon_process_frames(Building* building, const unsigned char* data, size_t len, DaemonBuffer* out);
+int daemon_run(Building* building, const char* socket_path);
+
+// Replica Functions
+int replica_publisher_open(ReplicaPublisher* publisher, const char* name);
+int replica_publish(ReplicaPublisher* publisher, Building* building);
+void replica_publisher_close(ReplicaPublisher* publisher);
+int replica_reader_open(ReplicaReader* reader, const char* name);
+int replica_reader_refresh(ReplicaReader* reader);
+void replica_reader_close(ReplicaReader* reader);
+const ReplicaRoom* replica_room(const ReplicaReader* reader, uint32_t index);
+const ReplicaGhost* replica_ghost(const ReplicaReader* reader, uint32_t index);
+const ReplicaGhost* replica_room_ghost(const ReplicaReader* reader, const ReplicaRoom* room, uint32_t rank);
+void replica_room_print(const ReplicaReader* reader, const ReplicaRoom* room);
+
+// Epoch Reclamation Functions
+void epoch_reader_register(EpochReader** reader);
+void epoch_reader_unregister(EpochReader** reader);
+void epoch_read_enter(EpochReader* reader);
+void epoch_read_exit(EpochReader* reader);
+void epoch_write_lock(void);
+void epoch_write_unlock(void);
+void epoch_retire(void* ptr, void (*free_fn)(void*));
+bool epoch_reclaim(void);
+size_t epoch_pending_count(void);
+void epoch_drain(void);
+
+// Packed Record Functions
+uint16_t packed_quantize_likelihood(float likelihood);
+float packed_dequantize_likelihood(uint16_t quantized);
+void packedstore_init(PackedStore* store, const RoomArray* rooms);
+bool packedstore_append(PackedStore* store, int id, const char* type, const Room* room, float likelihood);
+bool packedstore_load_building(PackedStore* store, const Building* building);
+bool packedstore_get(const PackedStore* store, int index, Ghost* out);
+void packedstore_print(const PackedStore* store);
+size_t packedstore_memory(const PackedStore* store);
+void packedstore_cleanup(PackedStore* store);
+
+// RingBuffer Functions
+void ring_init(RingBuffer* ring, size_t capacity, size_t item_size);
+bool ring_try_push(RingBuffer* ring, const void* item);
+bool ring_try_pop(RingBuffer* ring, void* item);
+void ring_push(RingBuffer* ring, const void* item);
+bool ring_pop(RingBuffer* ring, void* item);
+void ring_close(RingBuffer* ring);
+size_t ring_depth(const RingBuffer* ring);
+void ring_cleanup(RingBuffer* ring);
+
+// Ingest Pipeline Functions
+int pipeline_ingest(Building* building, FILE* input, int inserters, PipelineStats* stats);
+void pipeline_print_stats(const PipelineStats* stats);
+
+// Subscription Functions
+void subscription_registry_init(SubscriptionRegistry* registry);
+int subscription_register(SubscriptionRegistry* registry, const char* type, int room_id, float min_likelihood,
+                          bool new_head_only, AlertCallback callback, void* user);
+bool subscription_unregister(SubscriptionRegistry* registry, int id);
+void subscription_clear(SubscriptionRegistry* registry);
+void subscription_registry_cleanup(SubscriptionRegistry* registry);
+void subscription_notify(const Room* room, const Ghost* ghost, bool new_head);
+void subscription_notify_new_head(const Room* room, const Ghost* ghost);
+bool subscription_poll(SubscriptionRegistry* registry, AlertEvent* event);
+size_t subscription_dropped(SubscriptionRegistry* registry);
+
+// Id Allocator Functions
+int idspace_open(IdSpace* space, const char* path, int first_id, int block_size);
+int idspace_next(IdSpace* space);
+IdSpace* idspace_default(void);
+int idspace_close(IdSpace* space);
+
+// Columnar Export Functions
+int columnar_export(const Building* building, const char* path, uint32_t block_rows);
+int columnar_open(ColumnarReader* reader, const char* path);
+size_t columnar_scan(const ColumnarReader* reader, float min_likelihood, ColumnarRowCallback callback,
+                     void* user, ColumnarScanStats* stats);
+void columnar_close(ColumnarReader* reader);
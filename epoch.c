@@ -0,0 +1,215 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "defs.h"
+
+/* This file contains epoch-based reclamation for ghost lists. Readers mark
+   themselves active in the current global epoch and then traverse lists with
+   no locks. Writers unlink nodes immediately but hand them to epoch_retire;
+   a retired node is only freed once every active reader has moved past the
+   epoch in which it was unlinked. */
+
+// A retired pointer waiting for its grace period to end
+typedef struct EpochRetired EpochRetired;
+struct EpochRetired {
+    void* ptr;
+    void (*free_fn)(void*);
+    EpochRetired* next;
+};
+
+#define EPOCH_LIMBO_LISTS 3
+
+// Global epoch, starts at 1 so an active reader state is never 0
+static uint64_t global_epoch = 1;
+static EpochReader readers[EPOCH_MAX_READERS];
+
+// Retired pointers bucketed by the epoch they were retired in (epoch % 3)
+static EpochRetired* limbo[EPOCH_LIMBO_LISTS];
+static size_t pending = 0;
+
+static pthread_mutex_t limbo_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t writer_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+  Function: epoch_reader_register
+  Purpose:  Claims a reader slot for the calling thread.
+  Params:
+    out: reader - A double pointer to store the claimed slot, NULL if all
+                  EPOCH_MAX_READERS slots are taken.
+*/
+void epoch_reader_register(EpochReader** reader) {
+    if (reader == NULL) return;
+
+    for (int i = 0; i < EPOCH_MAX_READERS; i++) {
+        bool expected = false;
+        if (__atomic_compare_exchange_n(&readers[i].in_use, &expected, true, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            __atomic_store_n(&readers[i].state, 0, __ATOMIC_RELEASE);
+            *reader = &readers[i];
+            return;
+        }
+    }
+    printf("Warning: all %d epoch reader slots are in use\n", EPOCH_MAX_READERS);
+    *reader = NULL;
+}
+
+/*
+  Function: epoch_reader_unregister
+  Purpose:  Releases a reader slot. The reader must not be inside a read section.
+  Params:
+    in/out: reader - A double pointer to the slot, set to NULL.
+*/
+void epoch_reader_unregister(EpochReader** reader) {
+    if (reader == NULL || *reader == NULL) return;
+
+    __atomic_store_n(&(*reader)->state, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&(*reader)->in_use, false, __ATOMIC_RELEASE);
+    *reader = NULL;
+}
+
+/*
+  Function: epoch_read_enter
+  Purpose:  Starts a read section. Nodes reachable from a list during the
+            section stay valid until epoch_read_exit, even if unlinked.
+  Params:
+    in/out: reader - The calling thread's reader slot.
+*/
+void epoch_read_enter(EpochReader* reader) {
+    if (reader == NULL) return;
+
+    uint64_t epoch = __atomic_load_n(&global_epoch, __ATOMIC_ACQUIRE);
+    __atomic_store_n(&reader->state, (epoch << 1) | 1, __ATOMIC_RELAXED);
+    // Full fence so the announcement is visible before any list load
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+/*
+  Function: epoch_read_exit
+  Purpose:  Ends a read section. Node pointers from the section must not be used afterwards.
+  Params:
+    in/out: reader - The calling thread's reader slot.
+*/
+void epoch_read_exit(EpochReader* reader) {
+    if (reader == NULL) return;
+    __atomic_store_n(&reader->state, 0, __ATOMIC_RELEASE);
+}
+
+/*
+  Function: epoch_write_lock
+  Purpose:  Serializes writers. Readers never take this lock.
+*/
+void epoch_write_lock(void) {
+    pthread_mutex_lock(&writer_lock);
+}
+
+/*
+  Function: epoch_write_unlock
+  Purpose:  Releases the writer lock taken by epoch_write_lock.
+*/
+void epoch_write_unlock(void) {
+    pthread_mutex_unlock(&writer_lock);
+}
+
+/*
+  Function: epoch_retire
+  Purpose:  Schedules an unlinked pointer to be freed once no reader can still
+            hold it. The pointer must already be unreachable from every list.
+  Params:
+    in: ptr     - The pointer to free later.
+    in: free_fn - The function that frees it.
+*/
+void epoch_retire(void* ptr, void (*free_fn)(void*)) {
+    if (ptr == NULL || free_fn == NULL) return;
+
+    EpochRetired* retired = (EpochRetired*) malloc(sizeof(EpochRetired));
+    if (retired == NULL) {
+        printf("Error: malloc failed in epoch_retire\n");
+        exit(1);
+    }
+    retired->ptr = ptr;
+    retired->free_fn = free_fn;
+
+    pthread_mutex_lock(&limbo_lock);
+    // The epoch only advances under limbo_lock, so this bucket is the retire epoch
+    uint64_t epoch = __atomic_load_n(&global_epoch, __ATOMIC_RELAXED);
+    retired->next = limbo[epoch % EPOCH_LIMBO_LISTS];
+    limbo[epoch % EPOCH_LIMBO_LISTS] = retired;
+    size_t count = ++pending;
+    pthread_mutex_unlock(&limbo_lock);
+
+    // Amortize reclamation over retirements
+    if (count >= EPOCH_MAX_READERS) {
+        epoch_reclaim();
+    }
+}
+
+static size_t epoch_free_list(EpochRetired* retired) {
+    size_t freed = 0;
+    while (retired != NULL) {
+        EpochRetired* next = retired->next;
+        retired->free_fn(retired->ptr);
+        free(retired);
+        retired = next;
+        freed++;
+    }
+    return freed;
+}
+
+/*
+  Function: epoch_reclaim
+  Purpose:  Advances the global epoch if every active reader has caught up
+            with it, then frees everything retired in the previous epoch.
+  Returns:  true if the epoch advanced, false if a reader is still behind.
+*/
+bool epoch_reclaim(void) {
+    pthread_mutex_lock(&limbo_lock);
+    uint64_t epoch = __atomic_load_n(&global_epoch, __ATOMIC_RELAXED);
+
+    // Pairs with the fence in epoch_read_enter
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    for (int i = 0; i < EPOCH_MAX_READERS; i++) {
+        if (!__atomic_load_n(&readers[i].in_use, __ATOMIC_ACQUIRE)) continue;
+
+        uint64_t state = __atomic_load_n(&readers[i].state, __ATOMIC_ACQUIRE);
+        if ((state & 1) && (state >> 1) != epoch) {
+            pthread_mutex_unlock(&limbo_lock);
+            return false;
+        }
+    }
+
+    // Every active reader entered during `epoch`, after anything retired in
+    // `epoch - 1` was unlinked, so that bucket can go.
+    EpochRetired* expired = limbo[(epoch + 2) % EPOCH_LIMBO_LISTS];
+    limbo[(epoch + 2) % EPOCH_LIMBO_LISTS] = NULL;
+    __atomic_store_n(&global_epoch, epoch + 1, __ATOMIC_SEQ_CST);
+    pending -= epoch_free_list(expired);
+
+    pthread_mutex_unlock(&limbo_lock);
+    return true;
+}
+
+/*
+  Function: epoch_pending_count
+  Purpose:  Reports how many retired pointers are still waiting to be freed.
+  Returns:  The number of pending retirements.
+*/
+size_t epoch_pending_count(void) {
+    pthread_mutex_lock(&limbo_lock);
+    size_t count = pending;
+    pthread_mutex_unlock(&limbo_lock);
+    return count;
+}
+
+/*
+  Function: epoch_drain
+  Purpose:  Waits for readers to leave their read sections and frees every
+            retired pointer. Used during cleanup.
+*/
+void epoch_drain(void) {
+    while (epoch_pending_count() > 0) {
+        if (!epoch_reclaim()) {
+            sched_yield();
+        }
+    }
+}
@@ -5,6 +5,21 @@
 
 /* This file should contain all Ghost and GhostList specific functionality. */
 
+// Where ghost_create takes ids from; NULL means idspace_default()
+static IdSpace* ghost_ids = NULL;
+
+/*
+  Function: ghost_set_id_space
+  Purpose:  Chooses the id space new ghosts draw from, e.g. a persisted space
+            so ids are not reused across restarts. Call before any thread
+            creates ghosts.
+  Params:
+    in: space - An open IdSpace, or NULL for the default space.
+*/
+void ghost_set_id_space(IdSpace* space) {
+    ghost_ids = space;
+}
+
 /*
   Function: ghost_create
   Purpose:  Dynamically allocates and initializes a new Ghost structure.
@@ -13,8 +28,11 @@
     in:  type  - The type of the ghost to initialize.
 */
 void ghost_create(Ghost* *ghost, const char* type) {
-    // Use a static variable to assign a unique ID
-    static int next_id = GHOST_INITIAL_ID;
+    int id = idspace_next(ghost_ids != NULL ? ghost_ids : idspace_default());
+    if (id < 0) {
+        printf("Error: no ghost id available in ghost_create\n");
+        exit(1);
+    }
 
     *ghost = (Ghost*) malloc(sizeof(Ghost));
     if (*ghost == NULL) {
@@ -22,7 +40,7 @@ void ghost_create(Ghost* *ghost, const char* type) {
         exit(1);
     }
 
-    (*ghost)->id = next_id++;
+    (*ghost)->id = id;
     strcpy((*ghost)->type, type);
     (*ghost)->likelihood = 0.0;
     (*ghost)->room = NULL;
@@ -95,11 +113,12 @@ void ghostlist_push(GhostList* list, Ghost* ghost) {
     newNode->data = ghost;
     newNode->next = NULL;
 
+    // Release stores publish the fully initialized node to epoch readers
     if (list->head == NULL) { // List is empty
-        list->head = newNode;
+        __atomic_store_n(&list->head, newNode, __ATOMIC_RELEASE);
         list->tail = newNode;
     } else { // List has nodes
-        list->tail->next = newNode;
+        __atomic_store_n(&list->tail->next, newNode, __ATOMIC_RELEASE);
         list->tail = newNode;
     }
 }
@@ -123,9 +142,12 @@ void ghostlist_insert_by_likelihood(GhostList* list, Ghost* ghost) {
     newNode->data = ghost;
     newNode->next = NULL;
 
+    // Links are published with release stores so epoch readers never see a
+    // half-initialized node
+
     // Case 1: List is empty
     if (list->head == NULL) {
-        list->head = newNode;
+        __atomic_store_n(&list->head, newNode, __ATOMIC_RELEASE);
         list->tail = newNode;
         return;
     }
@@ -133,7 +155,7 @@ void ghostlist_insert_by_likelihood(GhostList* list, Ghost* ghost) {
     // Case 2: Insert at head (new likelihood is >= head's likelihood)
     if (ghost->likelihood >= list->head->data->likelihood) {
         newNode->next = list->head;
-        list->head = newNode;
+        __atomic_store_n(&list->head, newNode, __ATOMIC_RELEASE);
         return;
     }
 
@@ -146,7 +168,7 @@ void ghostlist_insert_by_likelihood(GhostList* list, Ghost* ghost) {
 
     // Insert newNode after curr
     newNode->next = curr->next;
-    curr->next = newNode;
+    __atomic_store_n(&curr->next, newNode, __ATOMIC_RELEASE);
 
     // Update tail if newNode was inserted at the end
     if (newNode->next == NULL) {
@@ -155,6 +177,41 @@ void ghostlist_insert_by_likelihood(GhostList* list, Ghost* ghost) {
 }
 
 
+/*
+  Function: ghostlist_remove
+  Purpose:  Unlinks the node holding a Ghost from the list. The node is handed
+            to epoch_retire rather than freed, so concurrent epoch readers
+            that are standing on it can keep walking. The Ghost is not freed.
+  Params:
+    in/out: list  - The list to remove from.
+    in:     ghost - The Ghost whose node should be removed.
+  Returns:  true if the ghost was found and removed, false otherwise.
+*/
+bool ghostlist_remove(GhostList* list, const Ghost* ghost) {
+    if (list == NULL || ghost == NULL) return false;
+
+    GhostNode* prev = NULL;
+    GhostNode* curr = list->head;
+    while (curr != NULL && curr->data != ghost) {
+        prev = curr;
+        curr = curr->next;
+    }
+    if (curr == NULL) return false;
+
+    // curr->next is left intact for readers still on this node
+    if (prev == NULL) {
+        __atomic_store_n(&list->head, curr->next, __ATOMIC_RELEASE);
+    } else {
+        __atomic_store_n(&prev->next, curr->next, __ATOMIC_RELEASE);
+    }
+    if (list->tail == curr) {
+        list->tail = prev;
+    }
+
+    epoch_retire(curr, free);
+    return true;
+}
+
 /*
   Function: ghostlist_print
   Purpose:  Prints all Ghosts in a GhostList.
@@ -164,10 +221,10 @@ void ghostlist_insert_by_likelihood(GhostList* list, Ghost* ghost) {
 void ghostlist_print(const GhostList* list) {
     if (list == NULL) return;
 
-    GhostNode* curr = list->head;
+    GhostNode* curr = ghostlist_read_head(list);
     while (curr != NULL) {
         ghost_print(curr->data);
-        curr = curr->next;
+        curr = ghostnode_read_next(curr);
     }
 }
 
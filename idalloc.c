@@ -0,0 +1,254 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include "defs.h"
+
+/* This file contains the id allocator. Each IdSpace hands ids out in blocks;
+   a thread keeps its current block in thread-local storage, so most calls
+   are a compare and an increment with no locks or atomics. A persisted space
+   writes a high-water mark ahead of the ids it gives out, so a restart (even
+   after a crash) resumes above every id that may have been used. */
+
+// One thread's current block for one space
+typedef struct IdBlock {
+    uint64_t generation;
+    int next;
+    int end;
+} IdBlock;
+
+// The space ghost_create uses unless told otherwise; never persisted
+static IdSpace default_space = {
+    .slot = 0,
+    .generation = 1,
+    .block_size = IDSPACE_DEFAULT_BLOCK,
+    .next = GHOST_INITIAL_ID,
+    .high_water = 0,
+    .path = "",
+    .lock_fd = -1,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static IdSpace* slots[IDSPACE_MAX_SPACES] = { &default_space };
+static uint64_t next_generation = 2;
+static pthread_mutex_t slots_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static _Thread_local IdBlock thread_blocks[IDSPACE_MAX_SPACES];
+
+/* Atomically replaces the id file with a new high-water mark: write a temp
+   file, fsync it, rename it over the old one, then fsync the directory. */
+static bool idspace_persist(const char* path, int high_water) {
+    char tmp[IDSPACE_PATH_MAX + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    char text[32];
+    int length = snprintf(text, sizeof(text), "%d\n", high_water);
+    bool ok = write(fd, text, (size_t) length) == length && fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+    ok = ok && rename(tmp, path) == 0;
+    if (!ok) {
+        unlink(tmp);
+        return false;
+    }
+
+    // Without this the rename itself could be lost on power failure
+    char dir[IDSPACE_PATH_MAX];
+    strcpy(dir, path);
+    char* slash = strrchr(dir, '/');
+    if (slash == NULL) strcpy(dir, ".");
+    else if (slash == dir) slash[1] = '\0';
+    else *slash = '\0';
+    int dir_fd = open(dir, O_RDONLY | O_DIRECTORY);
+    if (dir_fd >= 0) {
+        fsync(dir_fd);
+        close(dir_fd);
+    }
+    return true;
+}
+
+/* Takes an exclusive flock on "<path>.lock" for as long as the space is open.
+   The id file itself is replaced by rename, so it cannot carry the lock.
+   Returns the lock's fd, or -1 if it is held elsewhere or cannot be created. */
+static int idspace_lock_path(const char* path) {
+    char lock_path[IDSPACE_PATH_MAX + 8];
+    snprintf(lock_path, sizeof(lock_path), "%s.lock", path);
+
+    int fd = open(lock_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        printf("Error: could not open %s (%s)\n", lock_path, strerror(errno));
+        return -1;
+    }
+    if (flock(fd, LOCK_EX | LOCK_NB) < 0) {
+        if (errno == EWOULDBLOCK) printf("Error: id file %s is already in use\n", path);
+        else printf("Error: could not lock %s (%s)\n", lock_path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+  Function: idspace_open
+  Purpose:  Opens an independent id space. With a path, the space resumes
+            from the high-water mark stored there (if the file exists) and
+            keeps it ahead of every id handed out. The path is locked while
+            the space is open, so a second open of it (in this or any other
+            process) fails instead of handing out the same ids. The lock is
+            released on idspace_close or when the process exits.
+  Params:
+    out: space      - The space to initialize.
+    in:  path       - File holding the high-water mark, or NULL for a space that starts fresh every run.
+    in:  first_id   - The first id of a new space (at least 0).
+    in:  block_size - Ids per thread block. Smaller blocks keep ids denser
+                      when many threads allocate; larger ones lock less often.
+  Returns:  0 on success, -1 on failure.
+*/
+int idspace_open(IdSpace* space, const char* path, int first_id, int block_size) {
+    if (space == NULL || first_id < 0 || block_size < 1) return -1;
+    if (path != NULL && (path[0] == '\0' || strlen(path) >= IDSPACE_PATH_MAX)) return -1;
+
+    int lock_fd = -1;
+    if (path != NULL && (lock_fd = idspace_lock_path(path)) < 0) return -1;
+
+    int next = first_id;
+    if (path != NULL) {
+        FILE* file = fopen(path, "r");
+        if (file != NULL) {
+            int stored;
+            bool parsed = fscanf(file, "%d", &stored) == 1;
+            fclose(file);
+            if (!parsed || stored < 0) {
+                printf("Error: corrupt id file %s\n", path);
+                close(lock_fd);
+                return -1;
+            }
+            if (stored > next) next = stored;
+        } else if (errno != ENOENT) {
+            printf("Error: could not read id file %s (%s)\n", path, strerror(errno));
+            close(lock_fd);
+            return -1;
+        }
+    }
+
+    pthread_mutex_lock(&slots_lock);
+    int slot = -1;
+    for (int i = 1; i < IDSPACE_MAX_SPACES; i++) {
+        if (slots[i] == NULL) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0) {
+        pthread_mutex_unlock(&slots_lock);
+        if (lock_fd >= 0) close(lock_fd);
+        return -1;
+    }
+    slots[slot] = space;
+    space->generation = next_generation++;
+    pthread_mutex_unlock(&slots_lock);
+
+    space->slot = slot;
+    space->block_size = block_size;
+    space->next = next;
+    space->high_water = next;
+    space->lock_fd = lock_fd;
+    memset(space->path, 0, IDSPACE_PATH_MAX);
+    if (path != NULL) {
+        strcpy(space->path, path);
+    }
+    pthread_mutex_init(&space->lock, NULL);
+    return 0;
+}
+
+/* Slow path of idspace_next: reserves a fresh block for this thread */
+static int idspace_refill(IdSpace* space, IdBlock* block) {
+    pthread_mutex_lock(&space->lock);
+    if (space->next > INT_MAX - space->block_size) {
+        pthread_mutex_unlock(&space->lock);
+        return -1;
+    }
+    int start = space->next;
+    int end = start + space->block_size;
+
+    // Persist well past this block so most refills skip the disk
+    if (space->path[0] != '\0' && end > space->high_water) {
+        int reserve = space->block_size * IDSPACE_RESERVE_BLOCKS;
+        int high_water = end > INT_MAX - reserve ? INT_MAX : end + reserve;
+        if (!idspace_persist(space->path, high_water)) {
+            printf("Error: could not persist id file %s (%s)\n", space->path, strerror(errno));
+            pthread_mutex_unlock(&space->lock);
+            return -1;
+        }
+        space->high_water = high_water;
+    }
+    space->next = end;
+    pthread_mutex_unlock(&space->lock);
+
+    block->generation = space->generation;
+    block->next = start + 1;
+    block->end = end;
+    return start;
+}
+
+/*
+  Function: idspace_next
+  Purpose:  Returns a new id. Ids from one thread increase; ids from different
+            threads interleave by block. The space must not be closed while
+            any thread may still call this.
+  Params:
+    in/out: space - The space to allocate from.
+  Returns:  The id, or -1 if the space is exhausted or could not be persisted.
+*/
+int idspace_next(IdSpace* space) {
+    IdBlock* block = &thread_blocks[space->slot];
+    if (block->generation == space->generation && block->next < block->end) {
+        return block->next++;
+    }
+    return idspace_refill(space, block);
+}
+
+/*
+  Function: idspace_default
+  Purpose:  Returns the built-in space that starts at GHOST_INITIAL_ID.
+  Returns:  The default space.
+*/
+IdSpace* idspace_default(void) {
+    return &default_space;
+}
+
+/*
+  Function: idspace_close
+  Purpose:  Releases a space and its path lock. A persisted space records
+            exactly where it stopped, so a clean restart only skips the unused ends of thread
+            blocks instead of the whole reserve. The default space is never closed.
+  Params:
+    in/out: space - The space to close.
+  Returns:  0 on success, -1 if the final high-water mark could not be written.
+*/
+int idspace_close(IdSpace* space) {
+    if (space == NULL || space == &default_space) return 0;
+
+    int result = 0;
+    pthread_mutex_lock(&space->lock);
+    if (space->path[0] != '\0' && !idspace_persist(space->path, space->next)) {
+        printf("Error: could not persist id file %s (%s)\n", space->path, strerror(errno));
+        result = -1;
+    }
+    pthread_mutex_unlock(&space->lock);
+    pthread_mutex_destroy(&space->lock);
+    if (space->lock_fd >= 0) {
+        close(space->lock_fd); // Releases the flock
+        space->lock_fd = -1;
+    }
+
+    pthread_mutex_lock(&slots_lock);
+    if (slots[space->slot] == space) slots[space->slot] = NULL;
+    pthread_mutex_unlock(&slots_lock);
+    return result;
+}
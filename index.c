@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "defs.h"
+
+/* This file contains the GhostIndex: an open-addressing hash table keyed on
+   (ghost type, room id) that lets repeat sightings find their ghost without
+   walking any list. */
+
+/* FNV-1a over the type string, with the room id mixed in */
+static unsigned int ghostindex_hash(const char* type, int room_id) {
+    unsigned int hash = 2166136261u;
+    for (const unsigned char* c = (const unsigned char*) type; *c != '\0'; c++) {
+        hash ^= *c;
+        hash *= 16777619u;
+    }
+    hash ^= (unsigned int) room_id;
+    hash *= 16777619u;
+    return hash;
+}
+
+static bool ghostindex_matches(const GhostIndexEntry* entry, unsigned int hash, const char* type, int room_id) {
+    return entry->ghost != NULL && !entry->deleted && entry->hash == hash
+           && entry->room_id == room_id && strcmp(entry->ghost->type, type) == 0;
+}
+
+/* Allocates a table of the given capacity (a power of two) and reinserts all live entries */
+static void ghostindex_rehash(GhostIndex* index, int capacity) {
+    GhostIndexEntry* entries = (GhostIndexEntry*) calloc((size_t) capacity, sizeof(GhostIndexEntry));
+    if (entries == NULL) {
+        printf("Error: calloc failed in ghostindex_rehash\n");
+        exit(1);
+    }
+
+    for (int i = 0; i < index->capacity; i++) {
+        GhostIndexEntry* old = &(index->entries[i]);
+        if (old->ghost == NULL || old->deleted) continue;
+
+        int slot = (int) (old->hash & (unsigned int) (capacity - 1));
+        while (entries[slot].ghost != NULL) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        entries[slot] = *old;
+    }
+
+    free(index->entries);
+    index->entries = entries;
+    index->capacity = capacity;
+    index->tombstones = 0;
+}
+
+/*
+  Function: ghostindex_init
+  Purpose:  Initializes an empty GhostIndex.
+  Params:
+    out: index - The index to initialize.
+*/
+void ghostindex_init(GhostIndex* index) {
+    if (index == NULL) return;
+    index->entries = NULL;
+    index->capacity = 0;
+    index->count = 0;
+    index->tombstones = 0;
+}
+
+/*
+  Function: ghostindex_find
+  Purpose:  Looks up the ghost recorded for a (type, room id) pair.
+  Params:
+    in: index   - The index to search.
+    in: type    - The ghost type.
+    in: room_id - The id of the room.
+  Returns:  The matching entry, or NULL if there is none.
+*/
+GhostIndexEntry* ghostindex_find(const GhostIndex* index, const char* type, int room_id) {
+    if (index == NULL || type == NULL || index->capacity == 0) return NULL;
+
+    unsigned int hash = ghostindex_hash(type, room_id);
+    int slot = (int) (hash & (unsigned int) (index->capacity - 1));
+
+    // Tombstones keep the probe going; only a never-used slot ends it
+    while (index->entries[slot].ghost != NULL) {
+        if (ghostindex_matches(&(index->entries[slot]), hash, type, room_id)) {
+            return &(index->entries[slot]);
+        }
+        slot = (slot + 1) & (index->capacity - 1);
+    }
+    return NULL;
+}
+
+/*
+  Function: ghostindex_insert
+  Purpose:  Records a ghost under its (type, room id) pair. If the pair is
+            already present the existing entry is kept.
+  Params:
+    in/out: index   - The index to insert into.
+    in:     ghost   - The ghost to record.
+    in:     room_id - The id of the ghost's room.
+  Returns:  The entry for the pair.
+*/
+GhostIndexEntry* ghostindex_insert(GhostIndex* index, Ghost* ghost, int room_id) {
+    if (index == NULL || ghost == NULL) return NULL;
+
+    GhostIndexEntry* existing = ghostindex_find(index, ghost->type, room_id);
+    if (existing != NULL) return existing;
+
+    // Keep the load (live entries plus tombstones) under 3/4
+    if ((index->count + index->tombstones + 1) * 4 > index->capacity * 3) {
+        int capacity = index->capacity == 0 ? GHOST_INDEX_INITIAL_CAPACITY : index->capacity;
+        while ((index->count + 1) * 2 > capacity) {
+            capacity *= 2;
+        }
+        ghostindex_rehash(index, capacity);
+    }
+
+    unsigned int hash = ghostindex_hash(ghost->type, room_id);
+    int slot = (int) (hash & (unsigned int) (index->capacity - 1));
+    while (index->entries[slot].ghost != NULL && !index->entries[slot].deleted) {
+        slot = (slot + 1) & (index->capacity - 1);
+    }
+
+    GhostIndexEntry* entry = &(index->entries[slot]);
+    if (entry->deleted) index->tombstones--;
+    entry->ghost = ghost;
+    entry->room_id = room_id;
+    entry->hash = hash;
+    entry->reports = 1;
+    entry->deleted = false;
+    index->count++;
+    return entry;
+}
+
+/*
+  Function: ghostindex_remove
+  Purpose:  Removes a ghost's entry, leaving a tombstone so later probes still work.
+  Params:
+    in/out: index   - The index to remove from.
+    in:     ghost   - The ghost whose entry should be removed.
+    in:     room_id - The id of the ghost's room.
+  Returns:  true if the entry existed and pointed at this ghost.
+*/
+bool ghostindex_remove(GhostIndex* index, const Ghost* ghost, int room_id) {
+    if (index == NULL || ghost == NULL) return false;
+
+    GhostIndexEntry* entry = ghostindex_find(index, ghost->type, room_id);
+    if (entry == NULL || entry->ghost != ghost) return false;
+
+    entry->deleted = true;
+    index->count--;
+    index->tombstones++;
+    return true;
+}
+
+/*
+  Function: ghostindex_cleanup
+  Purpose:  Frees the index's table (but not the ghosts it points to).
+  Params:
+    in/out: index - The index to clean up.
+*/
+void ghostindex_cleanup(GhostIndex* index) {
+    if (index == NULL) return;
+    free(index->entries);
+    ghostindex_init(index);
+}
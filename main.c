@@ -1,18 +1,143 @@
 #include "defs.h"
 #include <stdio.h>
 #include <string.h>  // Add this for strcmp and snprintf in tests
+#include <pthread.h> // Concurrent reader tests
+#include <math.h>    // NAN for the daemon validation test
+#include <stdlib.h>  // mkstemp for the columnar export tests
+#include <time.h>    // Columnar throughput timing
+#include <unistd.h>
+#include <sys/wait.h> // Crash simulation for the id allocator tests
 
 /* A simple enumerator only used here for the menu options */
 enum MenuOptions { LOAD_SAMPLE_DATA = 1, PRINT_GHOST_LIST, PRINT_BUILDING_ROOMS, RUN_TEST_FUNCTION, EXIT_PROGRAM };
 enum MenuOptions print_menu();
 int run_test_function();
 
-int main(void) {
+/* Shared state for the concurrent epoch reader test */
+typedef struct EpochTestArgs {
+    Room* room;
+    volatile int stop;
+    int broken_order; // Set by a reader that walked off a corrupted list
+    long traversals;
+} EpochTestArgs;
+
+/* Alert callback for the subscription test: counts matches */
+static void subscription_test_callback(const AlertEvent* event, void* user) {
+    (void) event;
+    (*(int*) user)++;
+}
+
+/* Expected rows for the columnar scan test, compared in file order */
+typedef struct ColumnarTestArgs {
+    GhostNode* next;
+    int rows;
+    int mismatches;
+} ColumnarTestArgs;
+
+/* Row callback for the columnar test: checks each row against the main list */
+static void columnar_test_callback(const ColumnarRow* row, void* user) {
+    ColumnarTestArgs* args = (ColumnarTestArgs*) user;
+    args->rows++;
+    if (args->next == NULL) {
+        args->mismatches++;
+        return;
+    }
+
+    Ghost* ghost = args->next->data;
+    char want[16], got[16];
+    snprintf(want, sizeof(want), "%.2f", ghost->likelihood);
+    snprintf(got, sizeof(got), "%.2f", row->likelihood);
+    if (row->id != ghost->id || strcmp(row->type, ghost->type) != 0 || row->room_id != ghost->room->id
+        || strcmp(row->room_name, ghost->room->name) != 0 || strcmp(want, got) != 0) {
+        args->mismatches++;
+    }
+    args->next = args->next->next;
+}
+
+/* Row callback for the columnar benchmark: only counts */
+static void columnar_count_callback(const ColumnarRow* row, void* user) {
+    (void) row;
+    (*(size_t*) user)++;
+}
+
+/* Arguments for an id allocator thread: takes `count` ids into `ids` */
+typedef struct IdTestArgs {
+    IdSpace* space;
+    int* ids;
+    int count;
+} IdTestArgs;
+
+static void* idspace_test_thread(void* arg) {
+    IdTestArgs* args = (IdTestArgs*) arg;
+    for (int i = 0; i < args->count; i++) {
+        args->ids[i] = idspace_next(args->space);
+    }
+    return NULL;
+}
+
+static int idspace_test_compare(const void* a, const void* b) {
+    return (*(const int*) a > *(const int*) b) - (*(const int*) a < *(const int*) b);
+}
+
+static double test_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+/* Reader thread: walks the room list lock-free until told to stop */
+static void* epoch_test_reader(void* arg) {
+    EpochTestArgs* args = (EpochTestArgs*) arg;
+    EpochReader* reader;
+    epoch_reader_register(&reader);
+
+    long traversals = 0;
+    while (!__atomic_load_n(&args->stop, __ATOMIC_ACQUIRE)) {
+        epoch_read_enter(reader);
+        int seen = 0;
+        for (GhostNode* curr = ghostlist_read_head(&args->room->ghosts);
+             curr != NULL; curr = ghostnode_read_next(curr)) {
+            if (curr->data == NULL || ++seen > 1000) {
+                __atomic_store_n(&args->broken_order, 1, __ATOMIC_RELAXED);
+                break;
+            }
+        }
+        epoch_read_exit(reader);
+        traversals++;
+    }
+
+    __atomic_fetch_add(&args->traversals, traversals, __ATOMIC_RELAXED);
+    epoch_reader_unregister(&reader);
+    return NULL;
+}
+
+int main(int argc, char* argv[]) {
     Building building;
     enum MenuOptions choice;
 
     building_init(&building);
 
+    // Daemon mode: ./ghost_hunter --daemon <socket path> [id file]
+    if ((argc == 3 || argc == 4) && strcmp(argv[1], "--daemon") == 0) {
+        IdSpace ids;
+        if (argc == 4) {
+            // Persist ghost ids so a restarted daemon never reuses one
+            if (idspace_open(&ids, argv[3], GHOST_INITIAL_ID, IDSPACE_DEFAULT_BLOCK) != 0) {
+                printf("Error: could not open id file %s\n", argv[3]);
+                return 1;
+            }
+            ghost_set_id_space(&ids);
+        }
+        building_load_sample(&building);
+        int status = daemon_run(&building, argv[2]);
+        building_cleanup(&building);
+        if (argc == 4) {
+            ghost_set_id_space(NULL);
+            if (idspace_close(&ids) != 0) status = -1;
+        }
+        return status == 0 ? 0 : 1;
+    }
+
     do {
         choice = print_menu();
 
@@ -354,6 +479,808 @@ int run_test_function() {
     printf("  Actual: size=%d\n", array.size);
     printf("  Result: %s\n", (array.size == 0) ? "PASS" : "FAIL");
     
+    // ===================================================================
+    // TEST SECTION 5: Daemon Request Handling
+    // ===================================================================
+    printf("\n=== SECTION 5: Testing Daemon Request Handling ===\n");
+
+    Building daemon_building;
+    building_init(&daemon_building);
+    building_load_sample(&daemon_building);
+
+    // Test 5.1: Pipelined frames are all answered in one batch
+    printf("\nTest 5.1: Processing two pipelined requests\n");
+    DaemonBuffer requests, responses;
+    daemonbuffer_init(&requests);
+    daemonbuffer_init(&responses);
+
+    DaemonRequestHeader add_header = { DAEMON_OP_ADD_SIGHTING, 0, sizeof(DaemonSightingRequest) };
+    DaemonSightingRequest sighting;
+    memset(&sighting, 0, sizeof(sighting));
+    sighting.room_id = 4;
+    sighting.likelihood = 99.5f;
+    strcpy(sighting.type, "Revenant");
+    daemonbuffer_append(&requests, &add_header, sizeof(add_header));
+    daemonbuffer_append(&requests, &sighting, sizeof(sighting));
+
+    DaemonRequestHeader list_header = { DAEMON_OP_ROOM_LIST, 0, sizeof(int32_t) };
+    int32_t list_room = 4;
+    daemonbuffer_append(&requests, &list_header, sizeof(list_header));
+    daemonbuffer_append(&requests, &list_room, sizeof(list_room));
+
+    // Leave a partial third frame in the buffer; it must not be consumed
+    DaemonRequestHeader topk_header = { DAEMON_OP_TOP_K, 0, sizeof(uint32_t) };
+    daemonbuffer_append(&requests, &topk_header, sizeof(topk_header));
+
+    size_t consumed = daemon_process_frames(&daemon_building, requests.data, requests.len, &responses);
+    DaemonResponseHeader* add_resp = (DaemonResponseHeader*) responses.data;
+    DaemonResponseHeader* list_resp = (DaemonResponseHeader*)
+        (responses.data + sizeof(DaemonResponseHeader) + sizeof(DaemonRecord));
+    DaemonRecord* list_head = (DaemonRecord*) (list_resp + 1);
+    printf("  Expected: 2 frames consumed, kitchen list of 3 headed by Revenant\n");
+    printf("  Actual: consumed=%zu/%zu bytes, add status=%d, list count=%u, head=%s\n",
+           consumed, requests.len, add_resp->status, list_resp->count, list_head->type);
+    printf("  Result: %s\n",
+           (consumed == requests.len - sizeof(topk_header) && add_resp->status == DAEMON_OK
+            && list_resp->count == 3 && strcmp(list_head->type, "Revenant") == 0) ? "PASS" : "FAIL");
+
+    // Test 5.2: Top-K returns the highest likelihoods in descending order
+    printf("\nTest 5.2: Top-3 query across the building\n");
+    daemonbuffer_consume(&requests, consumed);
+    daemonbuffer_consume(&responses, responses.len);
+    uint32_t k = 3;
+    daemonbuffer_append(&requests, &k, sizeof(k));
+    daemon_process_frames(&daemon_building, requests.data, requests.len, &responses);
+    DaemonResponseHeader* topk_resp = (DaemonResponseHeader*) responses.data;
+    DaemonRecord* top = (DaemonRecord*) (topk_resp + 1);
+    printf("  Expected order: 99.50, 98.85, 98.74\n");
+    printf("  Actual order: ");
+    for (uint32_t i = 0; i < topk_resp->count; i++) {
+        printf("%.2f ", top[i].likelihood);
+    }
+    printf("\n  Result: %s\n",
+           (topk_resp->count == 3 && top[0].likelihood == 99.5f
+            && top[1].likelihood == 98.85f && top[2].likelihood == 98.74f) ? "PASS" : "FAIL");
+
+    // Test 5.3: Unknown rooms are rejected without touching the building
+    printf("\nTest 5.3: Listing a room that does not exist\n");
+    daemonbuffer_consume(&requests, requests.len);
+    daemonbuffer_consume(&responses, responses.len);
+    list_room = 999;
+    daemonbuffer_append(&requests, &list_header, sizeof(list_header));
+    daemonbuffer_append(&requests, &list_room, sizeof(list_room));
+    daemon_process_frames(&daemon_building, requests.data, requests.len, &responses);
+    DaemonResponseHeader* missing_resp = (DaemonResponseHeader*) responses.data;
+    printf("  Expected: status DAEMON_ERR_NO_ROOM, no records\n");
+    printf("  Actual: status=%d, count=%u\n", missing_resp->status, missing_resp->count);
+    printf("  Result: %s\n",
+           (missing_resp->status == DAEMON_ERR_NO_ROOM && missing_resp->count == 0) ? "PASS" : "FAIL");
+
+    // Test 5.4: Likelihoods outside 0 to 100 (and NaN) are rejected
+    printf("\nTest 5.4: Adding sightings with invalid likelihoods\n");
+    daemonbuffer_consume(&requests, requests.len);
+    daemonbuffer_consume(&responses, responses.len);
+    float bad_likelihoods[] = { -1.0f, 100.5f, NAN };
+    for (int i = 0; i < 3; i++) {
+        sighting.likelihood = bad_likelihoods[i];
+        daemonbuffer_append(&requests, &add_header, sizeof(add_header));
+        daemonbuffer_append(&requests, &sighting, sizeof(sighting));
+    }
+    daemon_process_frames(&daemon_building, requests.data, requests.len, &responses);
+    int bad_rejected = 0;
+    for (int i = 0; i < 3; i++) {
+        DaemonResponseHeader* bad_resp = (DaemonResponseHeader*) (responses.data + i * sizeof(DaemonResponseHeader));
+        if (bad_resp->status == DAEMON_ERR_BAD_REQUEST && bad_resp->count == 0) bad_rejected++;
+    }
+    printf("  Expected: 3 rejected with DAEMON_ERR_BAD_REQUEST, Revenant still 99.50\n");
+    printf("  Actual: %d rejected, Revenant %.2f\n", bad_rejected,
+           daemon_building.ghosts.tail->data->likelihood);
+    printf("  Result: %s\n", (bad_rejected == 3 && responses.len == 3 * sizeof(DaemonResponseHeader)
+                              && daemon_building.ghosts.tail->data->likelihood == 99.5f) ? "PASS" : "FAIL");
+
+    daemonbuffer_cleanup(&requests);
+    daemonbuffer_cleanup(&responses);
+    building_cleanup(&daemon_building);
+
+    // ===================================================================
+    // TEST SECTION 6: Shared-Memory Replica
+    // ===================================================================
+    printf("\n=== SECTION 6: Testing Shared-Memory Replica ===\n");
+
+    Building replica_building;
+    building_init(&replica_building);
+    building_load_sample(&replica_building);
+
+    // Test 6.1: A reader sees the published building without copying it
+    printf("\nTest 6.1: Publishing and mapping a replica\n");
+    ReplicaPublisher publisher;
+    ReplicaReader reader;
+    reader.header = NULL;
+    int published = replica_publisher_open(&publisher, "/ghost_hunter_test") == 0
+                    && replica_publish(&publisher, &replica_building) == 0;
+    int mapped = published && replica_reader_open(&reader, "/ghost_hunter_test") == 0;
+    const ReplicaRoom* kitchen = mapped ? replica_room(&reader, 3) : NULL;
+    const ReplicaGhost* kitchen_head = replica_room_ghost(&reader, kitchen, 0);
+    printf("  Expected: 8 rooms, 21 ghosts, Kitchen headed by Bullies (98.74)\n");
+    if (kitchen_head != NULL) {
+        printf("  Actual: %u rooms, %u ghosts, %s headed by %s (%.2f)\n",
+               reader.header->room_count, reader.header->ghost_count,
+               kitchen->name, kitchen_head->type, kitchen_head->likelihood);
+    }
+    printf("  Result: %s\n",
+           (kitchen_head != NULL && reader.header->room_count == 8 && reader.header->ghost_count == 21
+            && strcmp(kitchen->name, "Kitchen") == 0 && strcmp(kitchen_head->type, "Bullies") == 0)
+           ? "PASS" : "FAIL");
+
+    // Test 6.2: A new epoch is only visible after the reader refreshes
+    printf("\nTest 6.2: Refreshing to a newly published epoch\n");
+    util_ghost_create_and_add(&replica_building, "Revenant", replica_building.rooms.elements[3], 99.0f);
+    int republished = mapped && replica_publish(&publisher, &replica_building) == 0;
+    uint32_t before = mapped ? reader.header->ghost_count : 0;
+    int refreshed = republished ? replica_reader_refresh(&reader) : -1;
+    kitchen = replica_room(&reader, 3);
+    kitchen_head = replica_room_ghost(&reader, kitchen, 0);
+    printf("  Expected: old epoch keeps 21 ghosts, epoch 2 has 22 with Revenant heading Kitchen\n");
+    if (kitchen_head != NULL) {
+        printf("  Actual: before=%u, refreshed=%d, epoch=%llu, ghosts=%u, head=%s\n",
+               before, refreshed, (unsigned long long) reader.header->epoch,
+               reader.header->ghost_count, kitchen_head->type);
+    }
+    printf("  Result: %s\n",
+           (refreshed == 1 && before == 21 && reader.header->ghost_count == 22
+            && kitchen_head != NULL && strcmp(kitchen_head->type, "Revenant") == 0) ? "PASS" : "FAIL");
+
+    if (mapped) replica_reader_close(&reader);
+    replica_publisher_close(&publisher);
+    building_cleanup(&replica_building);
+
+    // ===================================================================
+    // TEST SECTION 7: Epoch-Based Reclamation
+    // ===================================================================
+    printf("\n=== SECTION 7: Testing Epoch-Based Reclamation ===\n");
+
+    Building epoch_building;
+    building_init(&epoch_building);
+    building_load_sample(&epoch_building);
+    Room* epoch_kitchen = roomarray_find(&epoch_building.rooms, 4);
+
+    // Test 7.1: An active reader delays reclamation of a removed ghost
+    printf("\nTest 7.1: Removing a ghost while a reader is active\n");
+    EpochReader* epoch_reader;
+    epoch_reader_register(&epoch_reader);
+    epoch_read_enter(epoch_reader);
+    GhostNode* held = ghostlist_read_head(&epoch_kitchen->ghosts);
+    Ghost* removed = held->data;
+    building_remove_ghost(&epoch_building, removed);
+    epoch_reclaim();
+    epoch_reclaim();
+    size_t pending_during = epoch_pending_count();
+    printf("  Expected: ghost unlinked from Kitchen, 3 retirements still pending, held node readable\n");
+    printf("  Actual: new head=%s, pending=%zu, held ghost=%s\n",
+           epoch_kitchen->ghosts.head->data->type, pending_during, held->data->type);
+    printf("  Result: %s\n",
+           (epoch_kitchen->ghosts.head->data != removed && pending_during == 3
+            && strcmp(held->data->type, "Bullies") == 0) ? "PASS" : "FAIL");
+
+    // Test 7.2: Retired memory is freed once the reader leaves
+    printf("\nTest 7.2: Reclaiming after the reader exits\n");
+    epoch_read_exit(epoch_reader);
+    epoch_reader_unregister(&epoch_reader);
+    epoch_drain();
+    printf("  Expected: pending=0\n");
+    printf("  Actual: pending=%zu\n", epoch_pending_count());
+    printf("  Result: %s\n", (epoch_pending_count() == 0) ? "PASS" : "FAIL");
+
+    // Test 7.3: Readers traverse while a writer repositions ghosts
+    printf("\nTest 7.3: Concurrent readers during 20000 repositions\n");
+    EpochTestArgs epoch_args = { epoch_kitchen, 0, 0, 0 };
+    pthread_t epoch_threads[4];
+    for (int i = 0; i < 4; i++) {
+        pthread_create(&epoch_threads[i], NULL, epoch_test_reader, &epoch_args);
+    }
+    Ghost* moving = epoch_kitchen->ghosts.head->data;
+    for (int i = 0; i < 20000; i++) {
+        epoch_write_lock();
+        room_reposition_ghost(epoch_kitchen, moving, (float) (i % 100));
+        epoch_write_unlock();
+        epoch_reclaim();
+    }
+    __atomic_store_n(&epoch_args.stop, 1, __ATOMIC_RELEASE);
+    for (int i = 0; i < 4; i++) {
+        pthread_join(epoch_threads[i], NULL);
+    }
+    epoch_drain();
+    int kitchen_size = 0;
+    for (GhostNode* node = epoch_kitchen->ghosts.head; node != NULL; node = node->next) {
+        kitchen_size++;
+    }
+    printf("  Expected: readers never saw a broken list, Kitchen still holds 1 ghost\n");
+    printf("  Actual: traversals=%ld, broken=%d, size=%d, pending=%zu\n",
+           epoch_args.traversals, epoch_args.broken_order, kitchen_size, epoch_pending_count());
+    printf("  Result: %s\n",
+           (!epoch_args.broken_order && kitchen_size == 1 && epoch_pending_count() == 0) ? "PASS" : "FAIL");
+
+    // Test 7.4: Read throughput against 1, 2 and 4 readers under a steady writer
+    printf("\nTest 7.4: Read throughput under a steady reposition writer\n");
+    for (int i = 0; i < 63; i++) {
+        util_ghost_create_and_add(&epoch_building, "Filler", epoch_kitchen, (float) (i % 100));
+    }
+    const int reader_counts[] = { 1, 2, 4 };
+    double single_rate = 0.0;
+    int scaling_broken = 0, scaling_idle = 0;
+    for (int run = 0; run < 3; run++) {
+        EpochTestArgs scaling_args = { epoch_kitchen, 0, 0, 0 };
+        pthread_t scaling_threads[4];
+        for (int i = 0; i < reader_counts[run]; i++) {
+            pthread_create(&scaling_threads[i], NULL, epoch_test_reader, &scaling_args);
+        }
+        long writes = 0;
+        double start = test_now();
+        while (test_now() - start < 0.25) {
+            epoch_write_lock();
+            room_reposition_ghost(epoch_kitchen, moving, (float) (writes % 100));
+            epoch_write_unlock();
+            epoch_reclaim();
+            writes++;
+        }
+        __atomic_store_n(&scaling_args.stop, 1, __ATOMIC_RELEASE);
+        for (int i = 0; i < reader_counts[run]; i++) {
+            pthread_join(scaling_threads[i], NULL);
+        }
+        double seconds = test_now() - start;
+        double rate = scaling_args.traversals / seconds;
+        if (run == 0) single_rate = rate;
+        if (scaling_args.broken_order) scaling_broken = 1;
+        if (scaling_args.traversals == 0) scaling_idle = 1;
+        printf("  %d reader(s): %.0f traversals/s (%.2fx one reader), %.0f writes/s\n",
+               reader_counts[run], rate, single_rate > 0 ? rate / single_rate : 0.0, writes / seconds);
+    }
+    epoch_drain();
+    printf("  Expected: every run traverses, no broken lists (scaling needs a core per reader)\n");
+    printf("  Actual: idle run=%s, broken=%s\n", scaling_idle ? "yes" : "no", scaling_broken ? "yes" : "no");
+    printf("  Result: %s\n", (!scaling_idle && !scaling_broken) ? "PASS" : "FAIL");
+
+    building_cleanup(&epoch_building);
+
+    // ===================================================================
+    // TEST SECTION 8: Packed Sighting Records
+    // ===================================================================
+    printf("\n=== SECTION 8: Testing Packed Sighting Records ===\n");
+
+    Building packed_building;
+    building_init(&packed_building);
+    building_load_sample(&packed_building);
+
+    // Test 8.1: Every sighting decodes to what ghost_print would show
+    printf("\nTest 8.1: Packing and decoding the sample building\n");
+    PackedStore store;
+    packedstore_init(&store, &packed_building.rooms);
+    bool packed_ok = packedstore_load_building(&store, &packed_building);
+    int mismatches = 0;
+    int index = 0;
+    for (GhostNode* node = packed_building.ghosts.head; node != NULL; node = node->next, index++) {
+        Ghost decoded;
+        char want[16], got[16];
+        packedstore_get(&store, index, &decoded);
+        snprintf(want, sizeof(want), "%.2f", node->data->likelihood);
+        snprintf(got, sizeof(got), "%.2f", decoded.likelihood);
+        if (decoded.id != node->data->id || strcmp(decoded.type, node->data->type) != 0
+            || decoded.room != node->data->room || strcmp(want, got) != 0) {
+            mismatches++;
+        }
+    }
+    printf("  Expected: 21 sightings, 0 mismatches\n");
+    printf("  Actual: %d sightings, %d mismatches\n", store.size, mismatches);
+    printf("  Result: %s\n", (packed_ok && store.size == 21 && mismatches == 0) ? "PASS" : "FAIL");
+
+    // Test 8.2: Memory per sighting, fixed overhead included
+    printf("\nTest 8.2: Comparing memory per sighting\n");
+    double linked_bytes = sizeof(Ghost) + 2 * sizeof(GhostNode); // Building list + room list
+    double sample_bytes = (double) packedstore_memory(&store) / store.size;
+    // Ids within PACKED_MAX_DELTA of each other keep blocks full, as in a building's main list
+    for (int i = 0; i < 979; i++) {
+        packedstore_append(&store, 2000 + i, "Wraith", packed_building.rooms.elements[i % 8], (float) (i % 100));
+    }
+    double packed_bytes = (double) packedstore_memory(&store) / store.size;
+    printf("  Expected: 21 sightings cost more than linked (fixed %zu-byte store);"
+           " 1000 with nearby ids at least 4x smaller\n", sizeof(PackedStore));
+    printf("  Actual: linked=%.0f bytes, packed 21=%.2f bytes, packed 1000=%.2f bytes (%.1fx)\n",
+           linked_bytes, sample_bytes, packed_bytes, linked_bytes / packed_bytes);
+    printf("  Result: %s\n", (sample_bytes > linked_bytes && linked_bytes / packed_bytes >= 4.0) ? "PASS" : "FAIL");
+
+    packedstore_cleanup(&store);
+    building_cleanup(&packed_building);
+
+    // ===================================================================
+    // TEST SECTION 9: Upserting Repeat Sightings
+    // ===================================================================
+    printf("\n=== SECTION 9: Testing Upserts ===\n");
+
+    Building upsert_building;
+    building_init(&upsert_building);
+    building_load_sample(&upsert_building);
+    Room* upsert_bathroom = roomarray_find(&upsert_building.rooms, 2);
+
+    // Test 9.1: Repeat reports update the existing ghost (MERGE_MAX)
+    printf("\nTest 9.1: Upserting Banshee in the Bathroom three times\n");
+    Ghost* banshee = upsert_building.rooms.elements[1]->ghosts.tail->data; // Banshee, 19.99
+    Ghost* first = building_upsert_ghost(&upsert_building, "Banshee", upsert_bathroom, 50.0f);
+    Ghost* second = building_upsert_ghost(&upsert_building, "Banshee", upsert_bathroom, 95.0f);
+    Ghost* third = building_upsert_ghost(&upsert_building, "Banshee", upsert_bathroom, 10.0f);
+    int ghost_total = 0;
+    for (GhostNode* node = upsert_building.ghosts.head; node != NULL; node = node->next) {
+        ghost_total++;
+    }
+    printf("  Expected: same ghost each time, likelihood 95.00 at head of Bathroom, 21 ghosts, 3 deduplicated\n");
+    printf("  Actual: same=%s, likelihood=%.2f, head=%s, ghosts=%d, deduplicated=%d\n",
+           (first == banshee && second == banshee && third == banshee) ? "yes" : "no",
+           banshee->likelihood, upsert_bathroom->ghosts.head->data->type,
+           ghost_total, upsert_building.deduplicated);
+    printf("  Result: %s\n",
+           (first == banshee && second == banshee && third == banshee && banshee->likelihood == 95.0f
+            && upsert_bathroom->ghosts.head->data == banshee && ghost_total == 21
+            && upsert_building.deduplicated == 3) ? "PASS" : "FAIL");
+
+    // Test 9.2: MERGE_AVERAGE keeps a running mean of the reports
+    printf("\nTest 9.2: Averaging reports for a new type\n");
+    upsert_building.merge_policy = MERGE_AVERAGE;
+    Ghost* shade = building_upsert_ghost(&upsert_building, "Shade", upsert_bathroom, 10.0f);
+    building_upsert_ghost(&upsert_building, "Shade", upsert_bathroom, 20.0f);
+    building_upsert_ghost(&upsert_building, "Shade", upsert_bathroom, 60.0f);
+    printf("  Expected: likelihood 30.00, third in Bathroom after Banshee and Yokai\n");
+    printf("  Actual: likelihood=%.2f, third=%s\n",
+           shade->likelihood, upsert_bathroom->ghosts.head->next->next->data->type);
+    printf("  Result: %s\n",
+           (shade->likelihood == 30.0f && upsert_bathroom->ghosts.head->next->next->data == shade)
+           ? "PASS" : "FAIL");
+
+    // Test 9.3: The same type in another room is a different ghost (MERGE_LATEST)
+    printf("\nTest 9.3: Upserting Banshee in the Kitchen with MERGE_LATEST\n");
+    upsert_building.merge_policy = MERGE_LATEST;
+    Room* upsert_kitchen = roomarray_find(&upsert_building.rooms, 4);
+    Ghost* kitchen_banshee = building_upsert_ghost(&upsert_building, "Banshee", upsert_kitchen, 1.0f);
+    printf("  Expected: the Kitchen Banshee, likelihood 1.00, now the Kitchen tail\n");
+    printf("  Actual: room=%s, likelihood=%.2f, tail=%s\n", kitchen_banshee->room->name,
+           kitchen_banshee->likelihood, upsert_kitchen->ghosts.tail->data->type);
+    printf("  Result: %s\n",
+           (kitchen_banshee != banshee && kitchen_banshee->room == upsert_kitchen
+            && kitchen_banshee->likelihood == 1.0f && upsert_kitchen->ghosts.tail->data == kitchen_banshee)
+           ? "PASS" : "FAIL");
+
+    building_cleanup(&upsert_building);
+
+    // ===================================================================
+    // TEST SECTION 10: Parallel Ingest Pipeline
+    // ===================================================================
+    printf("\n=== SECTION 10: Testing Parallel Ingest Pipeline ===\n");
+
+    // Test 10.1: SPSC ring preserves order and reports full
+    printf("\nTest 10.1: Filling and draining a ring buffer\n");
+    RingBuffer ring;
+    ring_init(&ring, 4, sizeof(int));
+    int pushed = 0, value = 0, in_order = 1;
+    while (ring_try_push(&ring, &pushed)) {
+        pushed++;
+    }
+    for (int i = 0; ring_try_pop(&ring, &value); i++) {
+        if (value != i) in_order = 0;
+    }
+    printf("  Expected: 4 items accepted, popped in order\n");
+    printf("  Actual: pushed=%d, in order=%s\n", pushed, in_order ? "yes" : "no");
+    printf("  Result: %s\n", (pushed == 4 && in_order && ring_depth(&ring) == 0) ? "PASS" : "FAIL");
+    ring_cleanup(&ring);
+
+    // Test 10.2: Ingesting a stream with three inserter threads
+    printf("\nTest 10.2: Ingesting 20000 lines through the pipeline\n");
+    Building pipeline_building, upsert_reference;
+    building_init(&pipeline_building);
+    building_load_sample(&pipeline_building);
+    building_init(&upsert_reference);
+    building_load_sample(&upsert_reference);
+    FILE* sightings = tmpfile();
+    for (int i = 0; i < 20000; i++) {
+        // 10000 distinct (type, room) pairs, each reported twice
+        int pair = i % 10000;
+        fprintf(sightings, "Type%d,%d,%d.%02d\n", pair / 8, 1 + pair % 8, (i * 37) % 100, i % 100);
+
+        char reference_type[MAX_STR];
+        snprintf(reference_type, sizeof(reference_type), "Type%d", pair / 8);
+        building_upsert_ghost(&upsert_reference, reference_type, upsert_reference.rooms.elements[pair % 8],
+                              (float) ((i * 37) % 100) + (float) (i % 100) / 100.0f);
+    }
+    fprintf(sightings, "not a sighting\nWraith,42,50.0\nWraith,1,150.0\n"); // 3 rejects
+    rewind(sightings);
+
+    PipelineStats pipeline_stats;
+    int ingested = pipeline_ingest(&pipeline_building, sightings, 3, &pipeline_stats);
+    fclose(sightings);
+    pipeline_print_stats(&pipeline_stats);
+
+    int rooms_sorted = 1, room_total = 0, master_total = 0;
+    for (int r = 0; r < pipeline_building.rooms.size; r++) {
+        GhostNode* node = pipeline_building.rooms.elements[r]->ghosts.head;
+        for (; node != NULL; node = node->next) {
+            room_total++;
+            if (node->next != NULL && node->next->data->likelihood > node->data->likelihood) rooms_sorted = 0;
+        }
+    }
+    for (GhostNode* node = pipeline_building.ghosts.head; node != NULL; node = node->next) {
+        master_total++;
+    }
+    // Every merged likelihood must match a sequential upsert of the same lines
+    int same_as_upsert = 1;
+    for (GhostNode* node = pipeline_building.ghosts.head; node != NULL; node = node->next) {
+        GhostIndexEntry* reference = ghostindex_find(&upsert_reference.index, node->data->type, node->data->room->id);
+        if (reference == NULL || reference->ghost->likelihood != node->data->likelihood) same_as_upsert = 0;
+    }
+    size_t rejected = pipeline_stats.stages[PIPELINE_PARSE].rejected
+                      + pipeline_stats.stages[PIPELINE_VALIDATE].rejected;
+    printf("  Expected: 10000 inserted, 10000 merged, 3 rejected, 10021 ghosts in rooms and main list,\n"
+           "            rooms sorted, likelihoods match sequential upserts\n");
+    printf("  Actual: inserted=%d, merged=%d, rejected=%zu, rooms=%d, main=%d, sorted=%s, match=%s\n",
+           ingested, pipeline_building.deduplicated, rejected, room_total, master_total,
+           rooms_sorted ? "yes" : "no", same_as_upsert ? "yes" : "no");
+    printf("  Result: %s\n",
+           (ingested == 10000 && pipeline_building.deduplicated == 10000 && rejected == 3
+            && room_total == 10021 && master_total == 10021 && rooms_sorted && same_as_upsert)
+           ? "PASS" : "FAIL");
+
+    building_cleanup(&pipeline_building);
+    building_cleanup(&upsert_reference);
+
+    // Test 10.3: An over-long line is rejected whole, not split into records
+    printf("\nTest 10.3: Ingesting a line longer than PIPELINE_LINE_MAX\n");
+    Building long_line_building;
+    building_init(&long_line_building);
+    building_load_sample(&long_line_building);
+    FILE* long_line = tmpfile();
+    for (int i = 0; i < 136; i++) {
+        fputc('X', long_line);
+    }
+    fprintf(long_line, "Wraith,1,50.0\nBanshee,1,40.0\n");
+    rewind(long_line);
+    int long_ingested = pipeline_ingest(&long_line_building, long_line, 1, &pipeline_stats);
+    fclose(long_line);
+    printf("  Expected: 1 inserted (Banshee), 1 rejected at parse\n");
+    printf("  Actual: inserted=%d, rejected=%zu, newest=%s\n", long_ingested,
+           pipeline_stats.stages[PIPELINE_PARSE].rejected, long_line_building.ghosts.tail->data->type);
+    printf("  Result: %s\n",
+           (long_ingested == 1 && pipeline_stats.stages[PIPELINE_PARSE].rejected == 1
+            && strcmp(long_line_building.ghosts.tail->data->type, "Banshee") == 0) ? "PASS" : "FAIL");
+    building_cleanup(&long_line_building);
+
+    // ===================================================================
+    // TEST SECTION 11: Threshold Subscriptions
+    // ===================================================================
+    printf("\n=== SECTION 11: Testing Threshold Subscriptions ===\n");
+
+    Building alert_building;
+    building_init(&alert_building);
+    SubscriptionRegistry* alerts = &(alert_building.subscriptions);
+    int wraith_alerts = 0;
+    int wraith_sub = subscription_register(alerts, "Wraith", SUBSCRIPTION_ANY_ROOM, 90.0f, false,
+                                           subscription_test_callback, &wraith_alerts);
+    subscription_register(alerts, NULL, 4, 0.0f, true, NULL, NULL); // Any new head of the Kitchen
+    subscription_register(alerts, NULL, SUBSCRIPTION_ANY_ROOM, 99.5f, false, NULL, NULL);
+    building_load_sample(&alert_building);
+
+    // Test 11.1: Callback fires only for matching type and threshold
+    printf("\nTest 11.1: Wraith sightings at or above 90%%\n");
+    printf("  Expected: 1 alert (Hallway, 97.99)\n");
+    printf("  Actual: %d alert(s)\n", wraith_alerts);
+    printf("  Result: %s\n", (wraith_alerts == 1) ? "PASS" : "FAIL");
+
+    // Test 11.2: New-head alerts are queued for polling
+    printf("\nTest 11.2: Polling new Kitchen heads\n");
+    AlertEvent alert;
+    int kitchen_alerts = 0;
+    float last_head = 0.0f;
+    while (subscription_poll(alerts, &alert)) {
+        kitchen_alerts++;
+        last_head = alert.likelihood;
+    }
+    printf("  Expected: 2 alerts (Banshee 82.51, then Bullies 98.74)\n");
+    printf("  Actual: %d alert(s), last head %.2f\n", kitchen_alerts, last_head);
+    printf("  Result: %s\n", (kitchen_alerts == 2 && last_head == 98.74f) ? "PASS" : "FAIL");
+
+    // Test 11.3: Unregistered subscriptions stop firing
+    printf("\nTest 11.3: Unregistering the Wraith subscription\n");
+    subscription_unregister(alerts, wraith_sub);
+    util_ghost_create_and_add(&alert_building, "Wraith", roomarray_find(&alert_building.rooms, 1), 99.9f);
+    int queued = 0;
+    while (subscription_poll(alerts, &alert)) {
+        queued++;
+    }
+    printf("  Expected: no new callback, 1 queued alert from the 99.5%% subscription\n");
+    printf("  Actual: callbacks=%d, queued=%d\n", wraith_alerts, queued);
+    printf("  Result: %s\n", (wraith_alerts == 1 && queued == 1) ? "PASS" : "FAIL");
+
+    // Test 11.4: New-head alerts follow the actual head of the Kitchen
+    printf("\nTest 11.4: Repositioning and removing the Kitchen head\n");
+    Room* alert_kitchen = roomarray_find(&alert_building.rooms, 4);
+    Ghost* head_bullies = alert_kitchen->ghosts.head->data; // 98.74
+    Ghost* head_banshee = alert_kitchen->ghosts.tail->data; // 82.51
+    int banshee_id = head_banshee->id; // The ghost is retired below
+    int head_alerts[3] = { 0, 0, 0 };
+    int head_ids[3] = { 0, 0, 0 };
+    room_reposition_ghost(alert_kitchen, head_bullies, 99.0f); // Stays head
+    for (; subscription_poll(alerts, &alert); head_alerts[0]++) head_ids[0] = alert.ghost_id;
+    room_reposition_ghost(alert_kitchen, head_bullies, 50.0f); // Banshee takes over
+    for (; subscription_poll(alerts, &alert); head_alerts[1]++) head_ids[1] = alert.ghost_id;
+    building_remove_ghost(&alert_building, head_banshee);      // Bullies is head again
+    for (; subscription_poll(alerts, &alert); head_alerts[2]++) head_ids[2] = alert.ghost_id;
+    printf("  Expected: no alert while Bullies stays head, then 1 for Banshee, then 1 for Bullies\n");
+    printf("  Actual: %d, %d (%s), %d (%s)\n", head_alerts[0], head_alerts[1],
+           head_ids[1] == banshee_id ? "Banshee" : "other", head_alerts[2],
+           head_ids[2] == head_bullies->id ? "Bullies" : "other");
+    printf("  Result: %s\n", (head_alerts[0] == 0 && head_alerts[1] == 1 && head_ids[1] == banshee_id
+                              && head_alerts[2] == 1 && head_ids[2] == head_bullies->id) ? "PASS" : "FAIL");
+
+    // Test 11.5: Another building's sightings never reach this registry
+    printf("\nTest 11.5: Sightings in a second building\n");
+    Building other_building;
+    building_init(&other_building);
+    building_load_sample(&other_building);
+    util_ghost_create_and_add(&other_building, "Wraith", roomarray_find(&other_building.rooms, 4), 99.9f);
+    int leaked = subscription_poll(alerts, &alert) ? 1 : 0;
+    printf("  Expected: no alerts in the first building\n");
+    printf("  Actual: %s\n", leaked ? "alert received" : "none");
+    printf("  Result: %s\n", !leaked ? "PASS" : "FAIL");
+    building_cleanup(&other_building);
+
+    building_cleanup(&alert_building);
+
+    // ===================================================================
+    // TEST SECTION 12: Deferred-Sort Rooms
+    // ===================================================================
+    printf("\n=== SECTION 12: Testing Deferred-Sort Rooms ===\n");
+
+    // The same sightings go to a sorted room and a deferred room
+    Room *sorted_room, *deferred_room;
+    room_create(&sorted_room, 200, "SortedRoom");
+    room_create(&deferred_room, 201, "DeferredRoom");
+    GhostList deferred_owner; // Owns the ghosts for cleanup
+    ghostlist_init(&deferred_owner);
+    const char* burst_types[] = { "Early70", "Early50", "A", "B", "C", "D", "E", "F", "G" };
+    float burst_likelihoods[] = { 70.0f, 50.0f, 50.0f, 70.0f, 50.0f, 90.0f, 70.0f, 10.0f, 95.0f };
+
+    // Test 12.1: Deferred appends stay pending until the first print merges them
+    printf("\nTest 12.1: Printing a deferred room after a burst\n");
+    for (int i = 0; i < 9; i++) {
+        if (i == 2) room_set_deferred(deferred_room, true); // First two arrive sorted
+        Ghost *sorted_ghost, *deferred_ghost;
+        ghost_create(&sorted_ghost, burst_types[i]);
+        ghost_create(&deferred_ghost, burst_types[i]);
+        ghostlist_push(&deferred_owner, sorted_ghost);
+        ghostlist_push(&deferred_owner, deferred_ghost);
+        room_add_ghost(sorted_room, sorted_ghost, burst_likelihoods[i]);
+        room_add_ghost(deferred_room, deferred_ghost, burst_likelihoods[i]);
+    }
+    int pending_before = 0;
+    for (GhostNode* node = deferred_room->pending.head; node != NULL; node = node->next) {
+        pending_before++;
+    }
+    int sorted_before = 0;
+    for (GhostNode* node = deferred_room->ghosts.head; node != NULL; node = node->next) {
+        sorted_before++;
+    }
+    room_print(deferred_room); // The first print after the burst merges it
+    int sorted_count = 0;
+    for (GhostNode* node = deferred_room->ghosts.head; node != NULL; node = node->next) {
+        sorted_count++;
+    }
+    printf("  Expected: 2 sorted + 7 pending before printing; 9 sorted, clean, head G after\n");
+    printf("  Actual: %d sorted + %d pending before; %d sorted, dirty=%s, head=%s after\n",
+           sorted_before, pending_before, sorted_count,
+           deferred_room->dirty ? "yes" : "no", deferred_room->ghosts.head->data->type);
+    printf("  Result: %s\n",
+           (sorted_before == 2 && pending_before == 7 && sorted_count == 9 && !deferred_room->dirty
+            && deferred_room->pending.head == NULL
+            && strcmp(deferred_room->ghosts.head->data->type, "G") == 0) ? "PASS" : "FAIL");
+
+    // Test 12.2: The merge gives exactly the sorted-insert order
+    printf("\nTest 12.2: Order after merging the burst\n");
+    int same_order = 1;
+    GhostNode* sorted_node = sorted_room->ghosts.head;
+    GhostNode* deferred_node = deferred_room->ghosts.head;
+    printf("  Expected order: G D E B Early70 C A Early50 F\n");
+    printf("  Actual order: ");
+    while (sorted_node != NULL && deferred_node != NULL) {
+        printf("%s ", deferred_node->data->type);
+        if (strcmp(sorted_node->data->type, deferred_node->data->type) != 0) same_order = 0;
+        sorted_node = sorted_node->next;
+        deferred_node = deferred_node->next;
+    }
+    printf("\n  Result: %s\n",
+           (same_order && sorted_node == NULL && deferred_node == NULL && !deferred_room->dirty
+            && deferred_room->pending.head == NULL
+            && strcmp(deferred_room->ghosts.tail->data->type, "F") == 0) ? "PASS" : "FAIL");
+
+    room_cleanup(&sorted_room);
+    room_cleanup(&deferred_room);
+    ghostlist_cleanup(&deferred_owner, true);
+
+    // ===================================================================
+    // TEST SECTION 13: Columnar Export
+    // ===================================================================
+    printf("\n=== SECTION 13: Testing Columnar Export ===\n");
+
+    char columnar_path[] = "/tmp/ghost_hunter_XXXXXX";
+    int columnar_fd = mkstemp(columnar_path);
+    if (columnar_fd >= 0) close(columnar_fd);
+
+    Building columnar_building;
+    building_init(&columnar_building);
+    building_load_sample(&columnar_building);
+
+    // Test 13.1: A full scan returns every sighting in list order
+    printf("\nTest 13.1: Exporting the sample building in blocks of 4 rows\n");
+    ColumnarReader columnar;
+    int exported = columnar_export(&columnar_building, columnar_path, 4);
+    int opened = columnar_open(&columnar, columnar_path);
+    ColumnarTestArgs columnar_args = { columnar_building.ghosts.head, 0, 0 };
+    ColumnarScanStats scan_stats;
+    columnar_scan(&columnar, 0.0f, columnar_test_callback, &columnar_args, &scan_stats);
+    printf("  Expected: 21 rows in 6 blocks, 0 mismatches\n");
+    printf("  Actual: %d rows in %zu blocks, %d mismatches\n",
+           columnar_args.rows, scan_stats.blocks_scanned, columnar_args.mismatches);
+    printf("  Result: %s\n",
+           (exported == 0 && opened == 0 && columnar_args.rows == 21 && scan_stats.blocks_scanned == 6
+            && columnar_args.mismatches == 0 && columnar_args.next == NULL) ? "PASS" : "FAIL");
+
+    // Test 13.2: Blocks whose maximum is below the predicate are never decoded
+    printf("\nTest 13.2: Scanning for likelihood >= 90\n");
+    size_t high = columnar_scan(&columnar, 90.0f, NULL, NULL, &scan_stats);
+    printf("  Expected: 3 rows (Wraith 97.99, Bullies 98.74, Bullies 98.85), 3 of 6 blocks skipped\n");
+    printf("  Actual: %zu rows, %zu of %zu blocks skipped\n", high, scan_stats.blocks_skipped,
+           scan_stats.blocks_scanned + scan_stats.blocks_skipped);
+    printf("  Result: %s\n", (high == 3 && scan_stats.blocks_skipped == 3 && scan_stats.blocks_scanned == 3)
+                              ? "PASS" : "FAIL");
+    columnar_close(&columnar);
+    building_cleanup(&columnar_building);
+
+    // Test 13.3: Throughput on a larger building whose likelihoods drift upward
+    printf("\nTest 13.3: Exporting and scanning 200000 sightings\n");
+    building_init(&columnar_building);
+    building_load_sample(&columnar_building);
+    for (int r = 0; r < columnar_building.rooms.size; r++) {
+        room_set_deferred(columnar_building.rooms.elements[r], true); // Appends stay O(1)
+    }
+    const int bench_rows = 200000;
+    size_t expected_high = 3; // From the sample data
+    for (int i = 0; i < bench_rows; i++) {
+        char type[MAX_STR];
+        snprintf(type, sizeof(type), "Type%d", i % 7);
+        float likelihood = 95.0f * i / bench_rows + (float) ((i * 37) % 500) / 100.0f;
+        if (packed_quantize_likelihood(likelihood) >= 9000) expected_high++;
+        util_ghost_create_and_add(&columnar_building, type, columnar_building.rooms.elements[i % 8], likelihood);
+    }
+
+    double start = test_now();
+    exported = columnar_export(&columnar_building, columnar_path, 0);
+    double export_seconds = test_now() - start;
+    opened = columnar_open(&columnar, columnar_path);
+    size_t all_rows = 0;
+    start = test_now();
+    columnar_scan(&columnar, 0.0f, columnar_count_callback, &all_rows, NULL);
+    double full_seconds = test_now() - start;
+    size_t high_rows = 0;
+    start = test_now();
+    columnar_scan(&columnar, 90.0f, columnar_count_callback, &high_rows, &scan_stats);
+    double high_seconds = test_now() - start;
+    double bytes_per_row = opened == 0 ? (double) columnar.size / (double) all_rows : 0.0;
+
+    printf("  Export: %.0f rows/s; full scan: %.0f rows/s; >= 90 scan: %.4f s\n",
+           (bench_rows + 21) / export_seconds, all_rows / full_seconds, high_seconds);
+    printf("  Expected: %d rows, %zu rows >= 90, most blocks skipped, under 4 bytes per row\n",
+           bench_rows + 21, expected_high);
+    printf("  Actual: %zu rows, %zu rows >= 90, %zu of %zu blocks skipped, %.2f bytes per row\n",
+           all_rows, high_rows, scan_stats.blocks_skipped, scan_stats.blocks_scanned + scan_stats.blocks_skipped,
+           bytes_per_row);
+    printf("  Result: %s\n",
+           (exported == 0 && opened == 0 && all_rows == (size_t) bench_rows + 21 && high_rows == expected_high
+            && scan_stats.blocks_skipped > scan_stats.blocks_scanned && bytes_per_row < 4.0) ? "PASS" : "FAIL");
+
+    columnar_close(&columnar);
+    building_cleanup(&columnar_building);
+    unlink(columnar_path);
+
+    // ===================================================================
+    // TEST SECTION 14: Persistent Id Allocator
+    // ===================================================================
+    printf("\n=== SECTION 14: Testing Persistent Id Allocator ===\n");
+
+    char id_path[] = "/tmp/ghost_hunter_ids_XXXXXX";
+    int id_fd = mkstemp(id_path);
+    if (id_fd >= 0) close(id_fd);
+    unlink(id_path); // Start with no id file
+
+    // Test 14.1: A crashed process's ids are never handed out again
+    printf("\nTest 14.1: Restarting after a crash\n");
+    fflush(stdout); // Keep the child from repeating buffered output
+    pid_t child = fork();
+    if (child == 0) {
+        IdSpace crashed;
+        if (idspace_open(&crashed, id_path, 1, 8) != 0) _exit(2);
+        for (int i = 0; i < 10; i++) {
+            if (idspace_next(&crashed) != 1 + i) _exit(3);
+        }
+        _exit(0); // No idspace_close: the high-water mark on disk is all that survives
+    }
+    int child_status = -1;
+    waitpid(child, &child_status, 0);
+    IdSpace ids;
+    int opened_ids = idspace_open(&ids, id_path, 1, 8);
+    int resumed = idspace_next(&ids);
+    printf("  Expected: child handed out 1-10, restart resumes above them at 137 (reserve of 16 blocks)\n");
+    printf("  Actual: child status=%d, resumed at %d\n",
+           WIFEXITED(child_status) ? WEXITSTATUS(child_status) : -1, resumed);
+    printf("  Result: %s\n", (WIFEXITED(child_status) && WEXITSTATUS(child_status) == 0 && opened_ids == 0
+                              && resumed == 137) ? "PASS" : "FAIL");
+
+    // Test 14.2: A clean shutdown only gives up the rest of the current block
+    printf("\nTest 14.2: Restarting after a clean close\n");
+    idspace_next(&ids);
+    idspace_next(&ids);
+    int closed_ids = idspace_close(&ids);
+    idspace_open(&ids, id_path, 1, 8);
+    resumed = idspace_next(&ids);
+    printf("  Expected: 137-139 used from block 137-144, restart resumes at 145\n");
+    printf("  Actual: resumed at %d\n", resumed);
+    printf("  Result: %s\n", (closed_ids == 0 && resumed == 145) ? "PASS" : "FAIL");
+
+    // Test 14.3: A second owner of the same id file is refused
+    printf("\nTest 14.3: Opening an id file that is already open\n");
+    IdSpace second_ids;
+    int second_while_open = idspace_open(&second_ids, id_path, 1, 8);
+    idspace_close(&ids);
+    int second_after_close = idspace_open(&second_ids, id_path, 1, 8);
+    int second_first = second_after_close == 0 ? idspace_next(&second_ids) : -1;
+    printf("  Expected: refused while open, then opens after close and resumes at 153 (after block 145-152)\n");
+    printf("  Actual: while open=%d, after close=%d, resumed at %d\n",
+           second_while_open, second_after_close, second_first);
+    printf("  Result: %s\n", (second_while_open == -1 && second_after_close == 0 && second_first == 153)
+                              ? "PASS" : "FAIL");
+    if (second_after_close == 0) idspace_close(&second_ids);
+    char id_lock_path[sizeof(id_path) + 8];
+    snprintf(id_lock_path, sizeof(id_lock_path), "%s.lock", id_path);
+    unlink(id_path);
+    unlink(id_lock_path);
+
+    // Test 14.4: Threads share a space without duplicates, and spaces are independent
+    printf("\nTest 14.4: Four threads taking 5000 ids each\n");
+    IdSpace shared_ids, other_ids;
+    idspace_open(&shared_ids, NULL, 0, 64);
+    idspace_open(&other_ids, NULL, 500, 64);
+    int other_first = idspace_next(&other_ids);
+    int* all_ids = (int*) malloc(sizeof(int) * 4 * 5000);
+    pthread_t id_threads[4];
+    IdTestArgs id_args[4];
+    for (int i = 0; i < 4; i++) {
+        id_args[i].space = &shared_ids;
+        id_args[i].ids = all_ids + i * 5000;
+        id_args[i].count = 5000;
+        pthread_create(&id_threads[i], NULL, idspace_test_thread, &id_args[i]);
+    }
+    for (int i = 0; i < 4; i++) {
+        pthread_join(id_threads[i], NULL);
+    }
+    qsort(all_ids, 4 * 5000, sizeof(int), idspace_test_compare);
+    int duplicates = 0;
+    for (int i = 1; i < 4 * 5000; i++) {
+        if (all_ids[i] == all_ids[i - 1]) duplicates++;
+    }
+    int span = all_ids[4 * 5000 - 1] - all_ids[0] + 1;
+    int other_second = idspace_next(&other_ids);
+    printf("  Expected: 0 duplicates, ids span at most 20000 + 4 blocks, other space 500 then 501\n");
+    printf("  Actual: %d duplicates, span %d, other space %d then %d\n",
+           duplicates, span, other_first, other_second);
+    printf("  Result: %s\n", (duplicates == 0 && all_ids[0] == 0 && span <= 4 * 5000 + 4 * 64
+                              && other_first == 500 && other_second == 501) ? "PASS" : "FAIL");
+    free(all_ids);
+    idspace_close(&shared_ids);
+    idspace_close(&other_ids);
+
     // ===================================================================
     // FINAL SUMMARY
     // ===================================================================
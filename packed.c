@@ -0,0 +1,253 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "defs.h"
+
+/* This file contains the packed sighting store: an archival representation
+   of ghosts that keeps about six bytes per sighting instead of a heap Ghost
+   plus one GhostNode per list it appears in. */
+
+/*
+  Function: packed_quantize_likelihood
+  Purpose:  Converts a likelihood percentage to fixed point in hundredths,
+            the same precision ghost_print shows.
+  Params:
+    in: likelihood - The likelihood, 0 to 100.
+  Returns:  The quantized likelihood, clamped to 0 to 10000.
+*/
+uint16_t packed_quantize_likelihood(float likelihood) {
+    float scaled = likelihood * PACKED_LIKELIHOOD_SCALE + 0.5f;
+    if (scaled <= 0.0f) return 0;
+    if (scaled >= 100 * PACKED_LIKELIHOOD_SCALE) return 100 * PACKED_LIKELIHOOD_SCALE;
+    return (uint16_t) scaled;
+}
+
+/*
+  Function: packed_dequantize_likelihood
+  Purpose:  Converts a fixed-point likelihood back to a percentage.
+  Params:
+    in: quantized - The likelihood in hundredths of a percent.
+  Returns:  The likelihood percentage.
+*/
+float packed_dequantize_likelihood(uint16_t quantized) {
+    return (float) quantized / PACKED_LIKELIHOOD_SCALE;
+}
+
+/*
+  Function: packedstore_init
+  Purpose:  Initializes an empty PackedStore.
+  Params:
+    out: store - The store to initialize.
+    in:  rooms - The rooms that sightings' room indices refer to.
+*/
+void packedstore_init(PackedStore* store, const RoomArray* rooms) {
+    if (store == NULL) return;
+    store->rooms = rooms;
+    store->type_count = 0;
+    store->blocks = NULL;
+    store->block_count = 0;
+    store->block_cap = 0;
+    store->size = 0;
+}
+
+/* Returns the dictionary index of a type, adding it if new; -1 if the dictionary is full */
+static int packedstore_intern_type(PackedStore* store, const char* type) {
+    // Newest types are the most likely to repeat, so search backwards
+    for (int i = store->type_count - 1; i >= 0; i--) {
+        if (strcmp(store->types[i], type) == 0) return i;
+    }
+    if (store->type_count == PACKED_MAX_TYPES) return -1;
+
+    strncpy(store->types[store->type_count], type, MAX_STR - 1);
+    store->types[store->type_count][MAX_STR - 1] = '\0';
+    return store->type_count++;
+}
+
+/* Returns the room's index in the store's RoomArray, PACKED_NO_ROOM for NULL, -1 if unknown */
+static int packedstore_room_index(const PackedStore* store, const Room* room) {
+    if (room == NULL) return PACKED_NO_ROOM;
+    for (int i = 0; store->rooms != NULL && i < store->rooms->size; i++) {
+        if (store->rooms->elements[i] == room) return i;
+    }
+    return -1;
+}
+
+/* Returns the last id stored in a block */
+static int packedblock_last_id(const PackedBlock* block) {
+    int id = block->base_id;
+    for (int i = 1; i < block->count; i++) {
+        id += block->id_delta[i];
+    }
+    return id;
+}
+
+/* Fills a Ghost from one slot of a block whose id has already been summed */
+static void packedblock_decode(const PackedStore* store, const PackedBlock* block, int slot, int id, Ghost* out) {
+    out->id = id;
+    strcpy(out->type, store->types[block->type[slot]]);
+    out->likelihood = packed_dequantize_likelihood(block->likelihood[slot]);
+    out->room = block->room[slot] == PACKED_NO_ROOM ? NULL : store->rooms->elements[block->room[slot]];
+}
+
+/* Starts a new block whose first sighting has the given id */
+static PackedBlock* packedstore_new_block(PackedStore* store, int id) {
+    if (store->block_count == store->block_cap) {
+        int cap = store->block_cap == 0 ? 4 : store->block_cap * 2;
+        PackedBlock* grown = (PackedBlock*) realloc(store->blocks, sizeof(PackedBlock) * cap);
+        if (grown == NULL) {
+            printf("Error: realloc failed in packedstore_new_block\n");
+            exit(1);
+        }
+        store->blocks = grown;
+        store->block_cap = cap;
+    }
+
+    PackedBlock* block = &(store->blocks[store->block_count++]);
+    memset(block, 0, sizeof(PackedBlock));
+    block->base_id = id;
+    block->first_index = store->size;
+    return block;
+}
+
+/*
+  Function: packedstore_append
+  Purpose:  Appends one sighting to the store. A new block is started when the
+            current one is full or the id does not follow the previous one
+            within PACKED_MAX_DELTA.
+  Params:
+    in/out: store      - The store to append to.
+    in:     id         - The ghost's id.
+    in:     type       - The ghost's type.
+    in:     room       - The ghost's room (must be in the store's RoomArray), or NULL.
+    in:     likelihood - The ghost's likelihood.
+  Returns:  true on success, false if the room is unknown or the type dictionary is full.
+*/
+bool packedstore_append(PackedStore* store, int id, const char* type, const Room* room, float likelihood) {
+    if (store == NULL || type == NULL) return false;
+
+    int room_index = packedstore_room_index(store, room);
+    if (room_index < 0) return false;
+    int type_index = packedstore_intern_type(store, type);
+    if (type_index < 0) return false;
+
+    PackedBlock* block = store->block_count > 0 ? &(store->blocks[store->block_count - 1]) : NULL;
+    uint8_t delta = 0;
+    if (block != NULL && block->count < PACKED_BLOCK_SIZE) {
+        int last = packedblock_last_id(block);
+        if (id >= last && id - last <= PACKED_MAX_DELTA) {
+            delta = (uint8_t) (id - last);
+        } else {
+            block = NULL;
+        }
+    } else {
+        block = NULL;
+    }
+    if (block == NULL) {
+        block = packedstore_new_block(store, id);
+    }
+
+    int slot = block->count++;
+    block->id_delta[slot] = delta;
+    block->type[slot] = (uint8_t) type_index;
+    block->room[slot] = (uint8_t) room_index;
+    block->likelihood[slot] = packed_quantize_likelihood(likelihood);
+    store->size++;
+    return true;
+}
+
+/*
+  Function: packedstore_load_building
+  Purpose:  Appends every ghost in the building's main list, in list order.
+  Params:
+    in/out: store    - The store to append to; should use the building's rooms.
+    in:     building - The building to pack.
+  Returns:  true if every ghost was packed.
+*/
+bool packedstore_load_building(PackedStore* store, const Building* building) {
+    if (store == NULL || building == NULL) return false;
+
+    bool ok = true;
+    for (GhostNode* curr = building->ghosts.head; curr != NULL; curr = curr->next) {
+        Ghost* ghost = curr->data;
+        ok = packedstore_append(store, ghost->id, ghost->type, ghost->room, ghost->likelihood) && ok;
+    }
+    return ok;
+}
+
+/*
+  Function: packedstore_get
+  Purpose:  Decodes one sighting back into a Ghost value.
+  Params:
+    in:  store - The store to read from.
+    in:  index - Position of the sighting, 0 to size - 1.
+    out: out   - The decoded ghost; its room points into the store's RoomArray.
+  Returns:  true on success, false if the index is out of range.
+*/
+bool packedstore_get(const PackedStore* store, int index, Ghost* out) {
+    if (store == NULL || out == NULL || index < 0 || index >= store->size) return false;
+
+    // Blocks can end early on an id gap, so binary search their start positions
+    int lo = 0, hi = store->block_count - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (store->blocks[mid].first_index <= index) lo = mid;
+        else hi = mid - 1;
+    }
+    const PackedBlock* block = &(store->blocks[lo]);
+    int slot = index - block->first_index;
+
+    int id = block->base_id;
+    for (int i = 1; i <= slot; i++) {
+        id += block->id_delta[i];
+    }
+    packedblock_decode(store, block, slot, id, out);
+    return true;
+}
+
+/*
+  Function: packedstore_print
+  Purpose:  Prints every sighting in the same format as ghostlist_print.
+  Params:
+    in: store - The store to print.
+*/
+void packedstore_print(const PackedStore* store) {
+    if (store == NULL) return;
+
+    // Decode block by block so ids are summed once per sighting
+    Ghost ghost;
+    for (int b = 0; b < store->block_count; b++) {
+        const PackedBlock* block = &(store->blocks[b]);
+        int id = block->base_id;
+        for (int slot = 0; slot < block->count; slot++) {
+            id += block->id_delta[slot];
+            packedblock_decode(store, block, slot, id, &ghost);
+            ghost_print(&ghost);
+        }
+    }
+}
+
+/*
+  Function: packedstore_memory
+  Purpose:  Reports the bytes the store occupies: the PackedStore itself,
+            including its fixed type dictionary, plus every allocated block
+            (used or not).
+  Params:
+    in: store - The store to measure.
+  Returns:  The number of bytes in use.
+*/
+size_t packedstore_memory(const PackedStore* store) {
+    if (store == NULL) return 0;
+    return sizeof(PackedStore) + sizeof(PackedBlock) * (size_t) store->block_cap;
+}
+
+/*
+  Function: packedstore_cleanup
+  Purpose:  Frees the store's blocks.
+  Params:
+    in/out: store - The store to clean up.
+*/
+void packedstore_cleanup(PackedStore* store) {
+    if (store == NULL) return;
+    free(store->blocks);
+    packedstore_init(store, store->rooms);
+}
@@ -0,0 +1,301 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "defs.h"
+
+/* This file contains the multi-stage ingest pipeline:
+
+     parse -> validate -> route -+-> insert (shard 0)
+                                 +-> insert (shard 1) ...
+
+   Each arrow is a bounded SPSC RingBuffer. Rooms are sharded by their index
+   in the RoomArray, and every shard is owned by exactly one inserter thread,
+   so ghostlist_insert_by_likelihood runs without locks. The building's main
+   list and index are only touched by the route thread, which creates a Ghost
+   for a new (type, room) pair and turns a repeat into a merge item for the
+   room's inserter, the same as building_upsert_ghost. */
+
+// A parsed but not yet validated sighting
+typedef struct PipelineRecord {
+    char type[MAX_STR];
+    int room_id;
+    float likelihood;
+} PipelineRecord;
+
+// A validated sighting with its resolved Room; route fills in the Ghost
+typedef struct PipelineItem {
+    char type[MAX_STR];
+    Ghost* ghost;
+    Room* room;
+    int room_index;
+    float likelihood;
+    int reports; // 0 for a new ghost, else reports merged into it counting this one
+} PipelineItem;
+
+typedef struct Pipeline Pipeline;
+
+// Arguments for one inserter thread
+typedef struct PipelineInserter {
+    Pipeline* pipeline;
+    RingBuffer queue;
+    PipelineStageStats stats;
+} PipelineInserter;
+
+struct Pipeline {
+    Building* building;
+    FILE* input;
+    int inserter_count;
+    RingBuffer parsed;    // parse -> validate
+    RingBuffer validated; // validate -> route
+    size_t merged;        // Repeat reports routed as merges
+    PipelineInserter inserters[PIPELINE_MAX_INSERTERS];
+    PipelineStageStats stages[PIPELINE_STAGES];
+};
+
+static double pipeline_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+/* Stage 1: turns "type,room_id,likelihood" lines into records */
+static void* pipeline_parse(void* arg) {
+    Pipeline* pipeline = (Pipeline*) arg;
+    PipelineStageStats* stats = &(pipeline->stages[PIPELINE_PARSE]);
+    double start = pipeline_now();
+
+    char line[PIPELINE_LINE_MAX];
+    while (fgets(line, sizeof(line), pipeline->input) != NULL) {
+        PipelineRecord record;
+        memset(&record, 0, sizeof(record));
+        stats->processed++;
+
+        // A line that does not fit is rejected whole, not parsed in pieces
+        if (strchr(line, '\n') == NULL) {
+            int c = fgetc(pipeline->input);
+            if (c != EOF && c != '\n') {
+                while (c != EOF && c != '\n') {
+                    c = fgetc(pipeline->input);
+                }
+                stats->rejected++;
+                continue;
+            }
+        }
+        if (sscanf(line, " %31[^,],%d,%f", record.type, &record.room_id, &record.likelihood) != 3) {
+            stats->rejected++;
+            continue;
+        }
+        ring_push(&pipeline->parsed, &record);
+    }
+    ring_close(&pipeline->parsed);
+
+    stats->seconds = pipeline_now() - start;
+    return NULL;
+}
+
+/* Stage 2: rejects bad likelihoods and unknown rooms */
+static void* pipeline_validate(void* arg) {
+    Pipeline* pipeline = (Pipeline*) arg;
+    PipelineStageStats* stats = &(pipeline->stages[PIPELINE_VALIDATE]);
+    RoomArray* rooms = &(pipeline->building->rooms);
+    double start = pipeline_now();
+
+    PipelineRecord record;
+    while (ring_pop(&pipeline->parsed, &record)) {
+        stats->processed++;
+        if (!(record.likelihood >= 0.0f && record.likelihood <= 100.0f)) {
+            stats->rejected++;
+            continue;
+        }
+
+        // Resolve the room id to its position, which also picks the shard
+        int room_index = -1;
+        for (int i = 0; i < rooms->size; i++) {
+            if (rooms->elements[i]->id == record.room_id) {
+                room_index = i;
+                break;
+            }
+        }
+        if (room_index < 0) {
+            stats->rejected++;
+            continue;
+        }
+
+        PipelineItem item;
+        memcpy(item.type, record.type, sizeof(item.type));
+        item.ghost = NULL;
+        item.room = rooms->elements[room_index];
+        item.room_index = room_index;
+        item.likelihood = record.likelihood;
+        item.reports = 0;
+        ring_push(&pipeline->validated, &item);
+    }
+    ring_close(&pipeline->validated);
+
+    stats->seconds = pipeline_now() - start;
+    return NULL;
+}
+
+/* Stage 3: upserts into the building's index and hands the result to its room's shard */
+static void* pipeline_route(void* arg) {
+    Pipeline* pipeline = (Pipeline*) arg;
+    PipelineStageStats* stats = &(pipeline->stages[PIPELINE_ROUTE]);
+    Building* building = pipeline->building;
+    double start = pipeline_now();
+
+    PipelineItem item;
+    while (ring_pop(&pipeline->validated, &item)) {
+        stats->processed++;
+        GhostIndexEntry* entry = ghostindex_find(&(building->index), item.type, item.room->id);
+        if (entry != NULL) {
+            // A repeat: the inserter owning the room merges it into the ghost
+            entry->reports++;
+            item.ghost = entry->ghost;
+            item.reports = entry->reports;
+            building->deduplicated++;
+            pipeline->merged++;
+        } else {
+            ghost_create(&item.ghost, item.type);
+            // Set before the ghost becomes visible on the main list
+            item.ghost->room = item.room;
+            item.ghost->likelihood = item.likelihood;
+            ghostlist_push(&(building->ghosts), item.ghost);
+            ghostindex_insert(&(building->index), item.ghost, item.room->id);
+        }
+
+        PipelineInserter* inserter = &(pipeline->inserters[item.room_index % pipeline->inserter_count]);
+        ring_push(&inserter->queue, &item);
+    }
+    for (int i = 0; i < pipeline->inserter_count; i++) {
+        ring_close(&(pipeline->inserters[i].queue));
+    }
+
+    stats->seconds = pipeline_now() - start;
+    return NULL;
+}
+
+/* Stage 4: sorted insertion and merges into rooms this thread alone owns */
+static void* pipeline_insert(void* arg) {
+    PipelineInserter* inserter = (PipelineInserter*) arg;
+    const Building* building = inserter->pipeline->building;
+    double start = pipeline_now();
+
+    PipelineItem item;
+    while (ring_pop(&inserter->queue, &item)) {
+        inserter->stats.processed++;
+        if (item.reports > 0) {
+            building_merge_report(building, item.ghost, item.likelihood, item.reports);
+        } else {
+            room_add_ghost(item.room, item.ghost, item.likelihood);
+        }
+    }
+
+    inserter->stats.seconds = pipeline_now() - start;
+    return NULL;
+}
+
+/*
+  Function: pipeline_ingest
+  Purpose:  Loads sightings from `input`, one "type,room_id,likelihood" per
+            line, through the parse, validate, route and insert stages running
+            on their own threads. Lines that do not parse, have a likelihood
+            outside 0 to 100, or name an unknown room are rejected, as are
+            lines longer than PIPELINE_LINE_MAX. Like building_upsert_ghost,
+            a repeat (type, room) is merged into the existing ghost by
+            building->merge_policy and counted in building->deduplicated.
+            Nothing else may write to the building while this runs.
+  Params:
+    in/out: building  - The building to load into; its rooms must already exist.
+    in:     input     - The stream to read.
+    in:     inserters - Number of inserter threads, 1 to PIPELINE_MAX_INSERTERS.
+    out:    stats     - Per-stage counters and timings, or NULL.
+  Returns:  The number of new ghosts inserted, or -1 on bad arguments.
+*/
+int pipeline_ingest(Building* building, FILE* input, int inserters, PipelineStats* stats) {
+    if (building == NULL || input == NULL || inserters < 1 || inserters > PIPELINE_MAX_INSERTERS) return -1;
+
+    Pipeline* pipeline = (Pipeline*) calloc(1, sizeof(Pipeline));
+    if (pipeline == NULL) {
+        printf("Error: calloc failed in pipeline_ingest\n");
+        exit(1);
+    }
+    pipeline->building = building;
+    pipeline->input = input;
+    pipeline->inserter_count = inserters;
+    ring_init(&pipeline->parsed, PIPELINE_RING_CAPACITY, sizeof(PipelineRecord));
+    ring_init(&pipeline->validated, PIPELINE_RING_CAPACITY, sizeof(PipelineItem));
+    for (int i = 0; i < inserters; i++) {
+        pipeline->inserters[i].pipeline = pipeline;
+        ring_init(&(pipeline->inserters[i].queue), PIPELINE_RING_CAPACITY, sizeof(PipelineItem));
+    }
+
+    double start = pipeline_now();
+    pthread_t parse_thread, validate_thread, route_thread, insert_threads[PIPELINE_MAX_INSERTERS];
+    for (int i = 0; i < inserters; i++) {
+        pthread_create(&insert_threads[i], NULL, pipeline_insert, &(pipeline->inserters[i]));
+    }
+    pthread_create(&route_thread, NULL, pipeline_route, pipeline);
+    pthread_create(&validate_thread, NULL, pipeline_validate, pipeline);
+    pthread_create(&parse_thread, NULL, pipeline_parse, pipeline);
+
+    pthread_join(parse_thread, NULL);
+    pthread_join(validate_thread, NULL);
+    pthread_join(route_thread, NULL);
+    for (int i = 0; i < inserters; i++) {
+        pthread_join(insert_threads[i], NULL);
+    }
+    double elapsed = pipeline_now() - start;
+
+    // Each stage's queue counters belong to the ring it produces into
+    pipeline->stages[PIPELINE_PARSE].full_stalls = pipeline->parsed.full_stalls;
+    pipeline->stages[PIPELINE_PARSE].max_queue_depth = pipeline->parsed.max_depth;
+    pipeline->stages[PIPELINE_VALIDATE].full_stalls = pipeline->validated.full_stalls;
+    pipeline->stages[PIPELINE_VALIDATE].max_queue_depth = pipeline->validated.max_depth;
+
+    PipelineStageStats* route = &(pipeline->stages[PIPELINE_ROUTE]);
+    PipelineStageStats* insert = &(pipeline->stages[PIPELINE_INSERT]);
+    for (int i = 0; i < inserters; i++) {
+        PipelineInserter* inserter = &(pipeline->inserters[i]);
+        route->full_stalls += inserter->queue.full_stalls;
+        if (inserter->queue.max_depth > route->max_queue_depth) {
+            route->max_queue_depth = inserter->queue.max_depth;
+        }
+        insert->processed += inserter->stats.processed;
+        if (inserter->stats.seconds > insert->seconds) {
+            insert->seconds = inserter->stats.seconds;
+        }
+        ring_cleanup(&inserter->queue);
+    }
+    ring_cleanup(&pipeline->parsed);
+    ring_cleanup(&pipeline->validated);
+
+    int inserted = (int) (insert->processed - pipeline->merged);
+    if (stats != NULL) {
+        memcpy(stats->stages, pipeline->stages, sizeof(stats->stages));
+        stats->inserters = inserters;
+        stats->seconds = elapsed;
+    }
+    free(pipeline);
+    return inserted;
+}
+
+/*
+  Function: pipeline_print_stats
+  Purpose:  Prints per-stage throughput and queue counters.
+  Params:
+    in: stats - Stats filled in by pipeline_ingest.
+*/
+void pipeline_print_stats(const PipelineStats* stats) {
+    if (stats == NULL) return;
+
+    const char* names[PIPELINE_STAGES] = { "parse", "validate", "route", "insert" };
+    printf("Pipeline: %d inserter(s), %.3f s\n", stats->inserters, stats->seconds);
+    for (int i = 0; i < PIPELINE_STAGES; i++) {
+        const PipelineStageStats* stage = &(stats->stages[i]);
+        double rate = stage->seconds > 0 ? stage->processed / stage->seconds : 0;
+        printf("  - {stage: %s, processed: %zu, rejected: %zu, items/s: %.0f, stalls: %zu, max depth: %zu}\n",
+               names[i], stage->processed, stage->rejected, rate, stage->full_stalls, stage->max_queue_depth);
+    }
+}
@@ -0,0 +1,378 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "defs.h"
+
+/* This file contains the shared-memory replica. A publisher flattens the
+   building into a fresh POSIX shared-memory segment per epoch and then flips
+   the epoch in a small control segment; readers map the current segment
+   read-only and walk its records in place. */
+
+// Maps a Ghost pointer to its index in the replica's ghost section
+typedef struct ReplicaSlot {
+    const Ghost* ghost;
+    uint32_t index;
+} ReplicaSlot;
+
+static int replica_slot_compare(const void* a, const void* b) {
+    const Ghost* ga = ((const ReplicaSlot*) a)->ghost;
+    const Ghost* gb = ((const ReplicaSlot*) b)->ghost;
+    return (ga > gb) - (ga < gb);
+}
+
+/* Builds the name of the data segment for an epoch, e.g. "/ghosts.7" */
+static void replica_segment_name(char* out, const char* name, uint64_t epoch) {
+    snprintf(out, REPLICA_NAME_MAX + 24, "%s.%llu", name, (unsigned long long) epoch);
+}
+
+/* Maps a shared-memory object; returns MAP_FAILED on error. Writable maps are
+   sized to *size; read-only maps must be at least *size and report the actual
+   object size back through it. */
+static void* replica_map(const char* name, int flags, size_t* size, bool writable) {
+    int fd = shm_open(name, flags, 0644);
+    if (fd < 0) return MAP_FAILED;
+
+    if (writable && ftruncate(fd, (off_t) *size) < 0) {
+        close(fd);
+        return MAP_FAILED;
+    }
+    if (!writable) {
+        struct stat st;
+        if (fstat(fd, &st) < 0 || (size_t) st.st_size < *size) {
+            close(fd);
+            return MAP_FAILED;
+        }
+        *size = (size_t) st.st_size;
+    }
+
+    void* addr = mmap(NULL, *size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // The mapping keeps the object alive
+    return addr;
+}
+
+/*
+  Function: replica_publisher_open
+  Purpose:  Creates (or takes over) the control segment for a replica.
+  Params:
+    out: publisher - The publisher to initialize.
+    in:  name      - Shared-memory name of the replica, e.g. "/ghost_hunter".
+  Returns:  0 on success, -1 on failure.
+*/
+int replica_publisher_open(ReplicaPublisher* publisher, const char* name) {
+    if (publisher == NULL || name == NULL || strlen(name) >= REPLICA_NAME_MAX) return -1;
+
+    strcpy(publisher->name, name);
+    size_t size = sizeof(ReplicaControl);
+    publisher->control = (ReplicaControl*) replica_map(name, O_CREAT | O_RDWR, &size, true);
+    if (publisher->control == MAP_FAILED) {
+        printf("Error: could not create replica %s (%s)\n", name, strerror(errno));
+        publisher->control = NULL;
+        return -1;
+    }
+
+    // Continue from whatever epoch a previous publisher left behind
+    publisher->control->magic = REPLICA_MAGIC;
+    publisher->epoch = __atomic_load_n(&publisher->control->epoch, __ATOMIC_ACQUIRE);
+    return 0;
+}
+
+/*
+  Function: replica_publish
+  Purpose:  Writes the building into a new data segment and atomically makes
+            it the current epoch. The previous segment is unlinked; readers
+            that still map it keep a consistent view until they refresh.
+            Deferred rooms are merged first (under epoch_write_lock), so
+            every published ghost appears in its room's run.
+  Params:
+    in/out: publisher - The publisher to write through.
+    in/out: building  - The building to publish.
+  Returns:  0 on success, -1 on failure.
+*/
+int replica_publish(ReplicaPublisher* publisher, Building* building) {
+    if (publisher == NULL || publisher->control == NULL || building == NULL) return -1;
+
+    epoch_write_lock();
+    building_flush(building);
+    epoch_write_unlock();
+
+    // Number the ghosts in building list order
+    uint32_t ghost_count = 0;
+    for (GhostNode* curr = building->ghosts.head; curr != NULL; curr = curr->next) {
+        ghost_count++;
+    }
+    ReplicaSlot* slots = (ReplicaSlot*) malloc(sizeof(ReplicaSlot) * (ghost_count + 1));
+    if (slots == NULL) {
+        printf("Error: malloc failed in replica_publish\n");
+        exit(1);
+    }
+    uint32_t index = 0;
+    for (GhostNode* curr = building->ghosts.head; curr != NULL; curr = curr->next) {
+        slots[index].ghost = curr->data;
+        slots[index].index = index;
+        index++;
+    }
+
+    uint32_t room_count = (uint32_t) building->rooms.size;
+    uint32_t room_ghost_count = 0;
+    for (uint32_t r = 0; r < room_count; r++) {
+        for (GhostNode* curr = building->rooms.elements[r]->ghosts.head; curr != NULL; curr = curr->next) {
+            room_ghost_count++;
+        }
+    }
+
+    size_t rooms_offset = sizeof(ReplicaHeader);
+    size_t ghosts_offset = rooms_offset + sizeof(ReplicaRoom) * room_count;
+    size_t room_ghosts_offset = ghosts_offset + sizeof(ReplicaGhost) * ghost_count;
+    size_t size = room_ghosts_offset + sizeof(uint32_t) * room_ghost_count;
+
+    uint64_t epoch = publisher->epoch + 1;
+    char segment[REPLICA_NAME_MAX + 24];
+    replica_segment_name(segment, publisher->name, epoch);
+    shm_unlink(segment); // Leftover from a crashed publisher
+
+    unsigned char* base = (unsigned char*) replica_map(segment, O_CREAT | O_EXCL | O_RDWR, &size, true);
+    if (base == MAP_FAILED) {
+        printf("Error: could not create replica segment %s (%s)\n", segment, strerror(errno));
+        free(slots);
+        return -1;
+    }
+
+    ReplicaHeader* header = (ReplicaHeader*) base;
+    ReplicaRoom* rooms = (ReplicaRoom*) (base + rooms_offset);
+    ReplicaGhost* ghosts = (ReplicaGhost*) (base + ghosts_offset);
+    uint32_t* room_ghosts = (uint32_t*) (base + room_ghosts_offset);
+
+    // Ghost records, in building list order
+    for (uint32_t i = 0; i < ghost_count; i++) {
+        const Ghost* ghost = slots[i].ghost;
+        ghosts[i].id = ghost->id;
+        ghosts[i].room_index = -1;
+        ghosts[i].likelihood = ghost->likelihood;
+        strcpy(ghosts[i].type, ghost->type);
+
+        for (uint32_t r = 0; r < room_count && ghost->room != NULL; r++) {
+            if (building->rooms.elements[r] == ghost->room) {
+                ghosts[i].room_index = (int32_t) r;
+                break;
+            }
+        }
+    }
+
+    // Room records, each pointing at a run of ghost indices in sorted order
+    qsort(slots, ghost_count, sizeof(ReplicaSlot), replica_slot_compare);
+    uint32_t next = 0;
+    for (uint32_t r = 0; r < room_count; r++) {
+        const Room* room = building->rooms.elements[r];
+        rooms[r].id = room->id;
+        strcpy(rooms[r].name, room->name);
+        rooms[r].ghost_first = next;
+
+        for (GhostNode* curr = room->ghosts.head; curr != NULL; curr = curr->next) {
+            ReplicaSlot key = { curr->data, 0 };
+            ReplicaSlot* found = (ReplicaSlot*) bsearch(&key, slots, ghost_count, sizeof(ReplicaSlot), replica_slot_compare);
+            if (found != NULL) {
+                room_ghosts[next++] = found->index;
+            }
+        }
+        rooms[r].ghost_count = next - rooms[r].ghost_first;
+    }
+    free(slots);
+
+    header->magic = REPLICA_MAGIC;
+    header->room_count = room_count;
+    header->ghost_count = ghost_count;
+    header->epoch = epoch;
+    header->rooms_offset = rooms_offset;
+    header->ghosts_offset = ghosts_offset;
+    header->room_ghosts_offset = room_ghosts_offset;
+    header->size = size;
+    munmap(base, size);
+
+    // Publish: readers that see the new epoch will find a complete segment
+    __atomic_store_n(&publisher->control->epoch, epoch, __ATOMIC_RELEASE);
+
+    if (publisher->epoch > 0) {
+        replica_segment_name(segment, publisher->name, publisher->epoch);
+        shm_unlink(segment);
+    }
+    publisher->epoch = epoch;
+    return 0;
+}
+
+/*
+  Function: replica_publisher_close
+  Purpose:  Unlinks the replica's segments and releases the control mapping.
+            Readers that still map a segment keep it until they close.
+  Params:
+    in/out: publisher - The publisher to close.
+*/
+void replica_publisher_close(ReplicaPublisher* publisher) {
+    if (publisher == NULL || publisher->control == NULL) return;
+
+    if (publisher->epoch > 0) {
+        char segment[REPLICA_NAME_MAX + 24];
+        replica_segment_name(segment, publisher->name, publisher->epoch);
+        shm_unlink(segment);
+    }
+    munmap(publisher->control, sizeof(ReplicaControl));
+    shm_unlink(publisher->name);
+    publisher->control = NULL;
+}
+
+/* Maps the data segment for the control segment's current epoch. Retries if
+   the publisher moves on (and unlinks the segment) between the two steps. */
+static int replica_reader_map_current(ReplicaReader* reader) {
+    for (int attempt = 0; attempt < REPLICA_OPEN_RETRIES; attempt++) {
+        uint64_t epoch = __atomic_load_n(&reader->control->epoch, __ATOMIC_ACQUIRE);
+        if (epoch == 0) return -1; // Nothing published yet
+
+        char segment[REPLICA_NAME_MAX + 24];
+        replica_segment_name(segment, reader->name, epoch);
+        size_t size = sizeof(ReplicaHeader);
+        const ReplicaHeader* header = (const ReplicaHeader*) replica_map(segment, O_RDONLY, &size, false);
+        if (header == MAP_FAILED) continue;
+
+        if (header->magic != REPLICA_MAGIC || header->epoch != epoch || header->size != size) {
+            munmap((void*) header, size);
+            return -1;
+        }
+        reader->header = header;
+        return 0;
+    }
+    return -1;
+}
+
+/*
+  Function: replica_reader_open
+  Purpose:  Maps the current epoch of a published replica read-only.
+  Params:
+    out: reader - The reader to initialize.
+    in:  name   - Shared-memory name the publisher was opened with.
+  Returns:  0 on success, -1 if no replica is available.
+*/
+int replica_reader_open(ReplicaReader* reader, const char* name) {
+    if (reader == NULL || name == NULL || strlen(name) >= REPLICA_NAME_MAX) return -1;
+
+    strcpy(reader->name, name);
+    reader->header = NULL;
+    size_t size = sizeof(ReplicaControl);
+    reader->control = (const ReplicaControl*) replica_map(name, O_RDONLY, &size, false);
+    if (reader->control == MAP_FAILED || reader->control->magic != REPLICA_MAGIC) {
+        if (reader->control != MAP_FAILED) munmap((void*) reader->control, sizeof(ReplicaControl));
+        reader->control = NULL;
+        return -1;
+    }
+    if (replica_reader_map_current(reader) < 0) {
+        replica_reader_close(reader);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+  Function: replica_reader_refresh
+  Purpose:  Switches the reader to the newest epoch if one has been published.
+            Any record pointers obtained before the call become invalid.
+  Params:
+    in/out: reader - The reader to refresh.
+  Returns:  1 if the reader moved to a new epoch, 0 if it was current, -1 on failure
+            (the reader keeps its old epoch).
+*/
+int replica_reader_refresh(ReplicaReader* reader) {
+    if (reader == NULL || reader->control == NULL || reader->header == NULL) return -1;
+
+    uint64_t epoch = __atomic_load_n(&reader->control->epoch, __ATOMIC_ACQUIRE);
+    if (epoch == reader->header->epoch) return 0;
+
+    const ReplicaHeader* old = reader->header;
+    if (replica_reader_map_current(reader) < 0) return -1;
+    munmap((void*) old, old->size);
+    return 1;
+}
+
+/*
+  Function: replica_reader_close
+  Purpose:  Releases the reader's mappings.
+  Params:
+    in/out: reader - The reader to close.
+*/
+void replica_reader_close(ReplicaReader* reader) {
+    if (reader == NULL) return;
+
+    if (reader->header != NULL) {
+        munmap((void*) reader->header, reader->header->size);
+        reader->header = NULL;
+    }
+    if (reader->control != NULL) {
+        munmap((void*) reader->control, sizeof(ReplicaControl));
+        reader->control = NULL;
+    }
+}
+
+/*
+  Function: replica_room
+  Purpose:  Returns a room record from the mapped segment.
+  Params:
+    in: reader - An open reader.
+    in: index  - Position of the room, 0 to header->room_count - 1.
+  Returns:  The room record, or NULL if out of range.
+*/
+const ReplicaRoom* replica_room(const ReplicaReader* reader, uint32_t index) {
+    if (reader == NULL || reader->header == NULL || index >= reader->header->room_count) return NULL;
+    const unsigned char* base = (const unsigned char*) reader->header;
+    return (const ReplicaRoom*) (base + reader->header->rooms_offset) + index;
+}
+
+/*
+  Function: replica_ghost
+  Purpose:  Returns a ghost record, in building list order.
+  Params:
+    in: reader - An open reader.
+    in: index  - Position of the ghost, 0 to header->ghost_count - 1.
+  Returns:  The ghost record, or NULL if out of range.
+*/
+const ReplicaGhost* replica_ghost(const ReplicaReader* reader, uint32_t index) {
+    if (reader == NULL || reader->header == NULL || index >= reader->header->ghost_count) return NULL;
+    const unsigned char* base = (const unsigned char*) reader->header;
+    return (const ReplicaGhost*) (base + reader->header->ghosts_offset) + index;
+}
+
+/*
+  Function: replica_room_ghost
+  Purpose:  Returns the ghost at a given rank of a room's sorted list.
+  Params:
+    in: reader - An open reader.
+    in: room   - A room record from the same reader.
+    in: rank   - Position in the room's list, 0 being the most likely.
+  Returns:  The ghost record, or NULL if out of range.
+*/
+const ReplicaGhost* replica_room_ghost(const ReplicaReader* reader, const ReplicaRoom* room, uint32_t rank) {
+    if (reader == NULL || reader->header == NULL || room == NULL || rank >= room->ghost_count) return NULL;
+    const unsigned char* base = (const unsigned char*) reader->header;
+    const uint32_t* room_ghosts = (const uint32_t*) (base + reader->header->room_ghosts_offset);
+    return replica_ghost(reader, room_ghosts[room->ghost_first + rank]);
+}
+
+/*
+  Function: replica_room_print
+  Purpose:  Prints a replica room in the same format as room_print.
+  Params:
+    in: reader - An open reader.
+    in: room   - A room record from the same reader.
+*/
+void replica_room_print(const ReplicaReader* reader, const ReplicaRoom* room) {
+    if (reader == NULL || room == NULL) return;
+
+    printf("{id: %d, name: %s}\n", room->id, room->name);
+    printf("  Ghosts:\n");
+    for (uint32_t rank = 0; rank < room->ghost_count; rank++) {
+        const ReplicaGhost* ghost = replica_room_ghost(reader, room, rank);
+        printf("  - {id: %d, type: %s, likelihood: %.2f%%, room: %s}\n",
+               ghost->id, ghost->type, ghost->likelihood, room->name);
+    }
+}
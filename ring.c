@@ -0,0 +1,146 @@
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "defs.h"
+
+/* This file contains the bounded single-producer/single-consumer ring buffer
+   that connects the stages of the ingest pipeline. head and tail only ever
+   increase; the slot is the index masked by capacity - 1. */
+
+/*
+  Function: ring_init
+  Purpose:  Allocates an empty ring buffer.
+  Params:
+    out: ring      - The ring to initialize.
+    in:  capacity  - Number of slots, a power of two.
+    in:  item_size - Size in bytes of each item.
+*/
+void ring_init(RingBuffer* ring, size_t capacity, size_t item_size) {
+    if (ring == NULL) return;
+
+    ring->slots = (unsigned char*) malloc(capacity * item_size);
+    if (ring->slots == NULL) {
+        printf("Error: malloc failed in ring_init\n");
+        exit(1);
+    }
+    ring->head = 0;
+    ring->tail = 0;
+    ring->closed = false;
+    ring->capacity = capacity;
+    ring->item_size = item_size;
+    ring->max_depth = 0;
+    ring->full_stalls = 0;
+}
+
+/*
+  Function: ring_try_push
+  Purpose:  Copies an item into the ring if there is room. Producer only.
+  Params:
+    in/out: ring - The ring to push to.
+    in:     item - The item to copy in.
+  Returns:  true if the item was pushed, false if the ring was full.
+*/
+bool ring_try_push(RingBuffer* ring, const void* item) {
+    size_t tail = ring->tail; // Only the producer writes tail
+    size_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    if (tail - head == ring->capacity) return false;
+
+    memcpy(ring->slots + (tail & (ring->capacity - 1)) * ring->item_size, item, ring->item_size);
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+
+    if (tail + 1 - head > ring->max_depth) {
+        ring->max_depth = tail + 1 - head;
+    }
+    return true;
+}
+
+/*
+  Function: ring_try_pop
+  Purpose:  Copies the oldest item out of the ring if there is one. Consumer only.
+  Params:
+    in/out: ring - The ring to pop from.
+    out:    item - Receives the item.
+  Returns:  true if an item was popped, false if the ring was empty.
+*/
+bool ring_try_pop(RingBuffer* ring, void* item) {
+    size_t head = ring->head; // Only the consumer writes head
+    size_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    if (head == tail) return false;
+
+    memcpy(item, ring->slots + (head & (ring->capacity - 1)) * ring->item_size, ring->item_size);
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/*
+  Function: ring_push
+  Purpose:  Pushes an item, yielding while the ring is full. This is the
+            pipeline's backpressure: a slow consumer stalls its producer
+            instead of letting the queue grow.
+  Params:
+    in/out: ring - The ring to push to.
+    in:     item - The item to copy in.
+*/
+void ring_push(RingBuffer* ring, const void* item) {
+    if (ring_try_push(ring, item)) return;
+
+    ring->full_stalls++;
+    while (!ring_try_push(ring, item)) {
+        sched_yield();
+    }
+}
+
+/*
+  Function: ring_pop
+  Purpose:  Pops an item, yielding while the ring is empty and still open.
+  Params:
+    in/out: ring - The ring to pop from.
+    out:    item - Receives the item.
+  Returns:  true if an item was popped, false once the ring is closed and drained.
+*/
+bool ring_pop(RingBuffer* ring, void* item) {
+    for (;;) {
+        if (ring_try_pop(ring, item)) return true;
+        if (__atomic_load_n(&ring->closed, __ATOMIC_ACQUIRE)) {
+            // Items pushed before close are visible now; take any last one
+            return ring_try_pop(ring, item);
+        }
+        sched_yield();
+    }
+}
+
+/*
+  Function: ring_close
+  Purpose:  Marks the end of the stream. Producer only, after its last push.
+  Params:
+    in/out: ring - The ring to close.
+*/
+void ring_close(RingBuffer* ring) {
+    __atomic_store_n(&ring->closed, true, __ATOMIC_RELEASE);
+}
+
+/*
+  Function: ring_depth
+  Purpose:  Reports how many items are currently queued. Safe from any thread.
+  Params:
+    in: ring - The ring to inspect.
+  Returns:  The number of queued items.
+*/
+size_t ring_depth(const RingBuffer* ring) {
+    size_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    size_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    return tail - head;
+}
+
+/*
+  Function: ring_cleanup
+  Purpose:  Frees the ring's slots.
+  Params:
+    in/out: ring - The ring to clean up.
+*/
+void ring_cleanup(RingBuffer* ring) {
+    if (ring == NULL) return;
+    free(ring->slots);
+    ring->slots = NULL;
+}
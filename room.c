@@ -23,12 +23,19 @@ void room_create(Room** room, int id, const char* name) {
     (*room)->id = id;
     strcpy((*room)->name, name);
     ghostlist_init(&((*room)->ghosts)); // Initialize the room's ghost list
+    ghostlist_init(&((*room)->pending));
+    (*room)->deferred = false;
+    (*room)->dirty = false;
+    (*room)->subscriptions = NULL;
 }
 
 /*
   Function: room_add_ghost
   Purpose:  Associates a ghost with a room and adds it to the room's
-            ghost list, sorted by likelihood.
+            ghost list, sorted by likelihood, then evaluates subscriptions.
+            In deferred mode the ghost is appended to the unsorted pending
+            list instead, which is merged by room_flush or by the next
+            room_print.
   Params:
     in/out: room       - The room to add the ghost to.
     in/out: ghost      - The ghost to add.
@@ -40,19 +47,214 @@ void room_add_ghost(Room* room, Ghost* ghost, float likelihood) {
     ghost->room = room;
     ghost->likelihood = likelihood;
 
+    // Deferred: O(1) append; new-head subscriptions wait for the flush
+    if (room->deferred) {
+        ghostlist_push(&(room->pending), ghost);
+        room->dirty = true;
+        subscription_notify(room, ghost, false);
+        return;
+    }
+
     // Add to the room's list, sorted by likelihood
     ghostlist_insert_by_likelihood(&(room->ghosts), ghost);
+
+    // Alert any matching subscribers
+    subscription_notify(room, ghost, room->ghosts.head->data == ghost);
+}
+
+/*
+  Function: room_reposition_ghost
+  Purpose:  Changes the likelihood of a ghost already in the room and moves it
+            to its new sorted position. The ghost gets a fresh node; the old one
+            is retired so concurrent epoch readers stay safe.
+  Params:
+    in/out: room       - The room holding the ghost.
+    in/out: ghost      - The ghost to move.
+    in:     likelihood - The ghost's new likelihood.
+  Returns:  true if the ghost was in the room, false otherwise.
+*/
+bool room_reposition_ghost(Room* room, Ghost* ghost, float likelihood) {
+    if (room == NULL || ghost == NULL) return false;
+
+    Ghost* old_head = room->ghosts.head != NULL ? room->ghosts.head->data : NULL;
+    if (!ghostlist_remove(&(room->ghosts), ghost)) {
+        // Not sorted yet: a pending ghost just takes its new likelihood
+        for (GhostNode* curr = room->pending.head; curr != NULL; curr = curr->next) {
+            if (curr->data == ghost) {
+                ghost->likelihood = likelihood;
+                subscription_notify(room, ghost, false);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    __atomic_store(&ghost->likelihood, &likelihood, __ATOMIC_RELAXED);
+    ghostlist_insert_by_likelihood(&(room->ghosts), ghost);
+
+    // A new likelihood can cross a subscriber's threshold. Staying at the
+    // head is not a new head; moving down hands the head to someone else.
+    Ghost* new_head = room->ghosts.head->data;
+    subscription_notify(room, ghost, new_head == ghost && old_head != ghost);
+    if (old_head == ghost && new_head != ghost) {
+        subscription_notify_new_head(room, new_head);
+    }
+    return true;
+}
+
+/*
+  Function: room_remove_ghost
+  Purpose:  Unlinks a ghost from the room, whether it is sorted or still
+            pending. The node is retired, the Ghost is not freed. If the
+            ghost was the head, the next ghost gets its new-head alerts.
+  Params:
+    in/out: room  - The room to remove from.
+    in:     ghost - The ghost to remove.
+  Returns:  true if the ghost was in the room.
+*/
+bool room_remove_ghost(Room* room, const Ghost* ghost) {
+    if (room == NULL || ghost == NULL) return false;
+
+    bool was_head = room->ghosts.head != NULL && room->ghosts.head->data == ghost;
+    if (ghostlist_remove(&(room->ghosts), ghost)) {
+        if (was_head && room->ghosts.head != NULL) {
+            subscription_notify_new_head(room, room->ghosts.head->data);
+        }
+        return true;
+    }
+    if (!ghostlist_remove(&(room->pending), ghost)) return false;
+
+    room->dirty = room->pending.head != NULL;
+    return true;
+}
+
+/*
+  Function: room_set_deferred
+  Purpose:  Switches a room between sorted inserts and append-now, sort-on-read.
+            Leaving deferred mode flushes any pending ghosts.
+  Params:
+    in/out: room     - The room to configure.
+    in:     deferred - true to defer sorting.
+*/
+void room_set_deferred(Room* room, bool deferred) {
+    if (room == NULL) return;
+
+    room->deferred = deferred;
+    if (!deferred) {
+        room_flush(room);
+    }
+}
+
+/* Stable merge of two chains sorted by descending likelihood; on ties `a` goes first */
+static GhostNode* room_merge_chains(GhostNode* a, GhostNode* b) {
+    GhostNode merged;
+    GhostNode* tail = &merged;
+    while (a != NULL && b != NULL) {
+        if (a->data->likelihood >= b->data->likelihood) {
+            tail->next = a;
+            a = a->next;
+        } else {
+            tail->next = b;
+            b = b->next;
+        }
+        tail = tail->next;
+    }
+    tail->next = a != NULL ? a : b;
+    return merged.next;
+}
+
+/* Stable merge sort of a node chain by descending likelihood */
+static GhostNode* room_sort_chain(GhostNode* head) {
+    if (head == NULL || head->next == NULL) return head;
+
+    // Split in half with slow/fast pointers
+    GhostNode* slow = head;
+    GhostNode* fast = head->next;
+    while (fast != NULL && fast->next != NULL) {
+        slow = slow->next;
+        fast = fast->next->next;
+    }
+    GhostNode* back = slow->next;
+    slow->next = NULL;
+
+    return room_merge_chains(room_sort_chain(head), room_sort_chain(back));
+}
+
+/*
+  Function: room_flush
+  Purpose:  Sorts the pending ghosts and merges them into the room's list in
+            one pass. The result is the order that inserting them one at a
+            time with ghostlist_insert_by_likelihood would give: on equal
+            likelihoods the later ghost comes first. This is a write: with
+            concurrent writers the caller must hold epoch_write_lock. Nodes
+            are spliced in with release stores, so epoch readers stay safe.
+  Params:
+    in/out: room - The room to flush.
+*/
+void room_flush(Room* room) {
+    if (room == NULL || !room->dirty) return;
+
+    // Reverse the arrival order so the stable sort puts later ghosts first on ties
+    GhostNode* chain = NULL;
+    GhostNode* curr = room->pending.head;
+    while (curr != NULL) {
+        GhostNode* next = curr->next;
+        curr->next = chain;
+        chain = curr;
+        curr = next;
+    }
+    ghostlist_init(&(room->pending));
+    room->dirty = false;
+    chain = room_sort_chain(chain);
+
+    GhostNode* old_head = room->ghosts.head;
+
+    // Walk the sorted list once; each pending ghost goes before the first
+    // existing ghost whose likelihood it matches or beats
+    GhostNode* prev = NULL;
+    GhostNode* at = room->ghosts.head;
+    while (chain != NULL) {
+        GhostNode* node = chain;
+        chain = chain->next;
+
+        while (at != NULL && at->data->likelihood > node->data->likelihood) {
+            prev = at;
+            at = at->next;
+        }
+        node->next = at;
+        if (prev == NULL) {
+            __atomic_store_n(&(room->ghosts.head), node, __ATOMIC_RELEASE);
+        } else {
+            __atomic_store_n(&(prev->next), node, __ATOMIC_RELEASE);
+        }
+        if (at == NULL) {
+            room->ghosts.tail = node;
+        }
+        prev = node;
+    }
+
+    if (room->ghosts.head != old_head) {
+        subscription_notify_new_head(room, room->ghosts.head->data);
+    }
 }
 
 /*
   Function: room_print
-  Purpose:  Prints the details of a single room and its ghosts.
+  Purpose:  Prints the details of a single room and its ghosts. The first
+            print after a deferred burst merges the pending ghosts under
+            epoch_write_lock, so the listing is always complete.
   Params:
-    in: room - The room to print.
+    in/out: room - The room to print.
 */
-void room_print(const Room* room) {
+void room_print(Room* room) {
     if (room == NULL) return;
 
+    if (room->dirty) {
+        epoch_write_lock();
+        room_flush(room);
+        epoch_write_unlock();
+    }
+
     // Print room details matching screenshot format
     printf("{id: %d, name: %s}\n", room->id, room->name);
     printf("  Ghosts:\n");
@@ -72,6 +274,7 @@ void room_cleanup(Room** room) {
 
     // Clean up the room's ghost list nodes, but NOT the ghost data
     ghostlist_cleanup(&((*room)->ghosts), false);
+    ghostlist_cleanup(&((*room)->pending), false);
 
     free(*room); // Free the room struct itself
     *room = NULL;
@@ -115,11 +318,12 @@ void roomarray_add(RoomArray* array, Room* room) {
 
 /*
   Function: roomarray_print
-  Purpose:  Prints all Rooms in the RoomArray.
+  Purpose:  Prints all Rooms in the RoomArray, merging deferred rooms first
+            (see room_print).
   Params:
-    in: array - The array to print.
+    in/out: array - The array to print.
 */
-void roomarray_print(const RoomArray* array) {
+void roomarray_print(RoomArray* array) {
     if (array == NULL) return;
 
     for (int i = 0; i < array->size; i++) {
@@ -127,6 +331,25 @@ void roomarray_print(const RoomArray* array) {
     }
 }
 
+/*
+  Function: roomarray_find
+  Purpose:  Looks up a Room in the RoomArray by its id.
+  Params:
+    in: array - The array to search.
+    in: id    - The id of the room to find.
+  Returns:  The matching Room, or NULL if no room has that id.
+*/
+Room* roomarray_find(const RoomArray* array, int id) {
+    if (array == NULL) return NULL;
+
+    for (int i = 0; i < array->size; i++) {
+        if (array->elements[i]->id == id) {
+            return array->elements[i];
+        }
+    }
+    return NULL;
+}
+
 /*
   Function: roomarray_cleanup
   Purpose:  Frees all Rooms stored within the RoomArray.
@@ -0,0 +1,331 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "defs.h"
+
+/* This file contains threshold subscriptions. Each Building has its own
+   registry. Predicates are bucketed by a hash of (room id, type), where
+   either may be a wildcard, and each bucket is kept sorted by minimum
+   likelihood. A sighting therefore only looks at the four buckets its room
+   and type can match, instead of every subscriber. */
+
+static unsigned int subscription_hash(const char* type) {
+    unsigned int hash = 2166136261u;
+    for (const unsigned char* c = (const unsigned char*) type; *c != '\0'; c++) {
+        hash ^= *c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Hash of the empty string: the key for "any type"
+#define SUBSCRIPTION_ANY_TYPE_HASH 2166136261u
+
+static int subscription_bucket_index(int room_id, unsigned int type_hash) {
+    unsigned int hash = type_hash ^ ((unsigned int) room_id * 2654435761u);
+    hash ^= hash >> 16;
+    return (int) (hash & (SUBSCRIPTION_BUCKETS - 1));
+}
+
+/*
+  Function: subscription_registry_init
+  Purpose:  Initializes an empty registry with an empty alert queue.
+  Params:
+    out: registry - The registry to initialize.
+*/
+void subscription_registry_init(SubscriptionRegistry* registry) {
+    if (registry == NULL) return;
+
+    memset(registry->buckets, 0, sizeof(registry->buckets));
+    registry->count = 0;
+    registry->next_id = 1;
+    pthread_rwlock_init(&registry->lock, NULL);
+
+    registry->queue = (AlertEvent*) malloc(sizeof(AlertEvent) * SUBSCRIPTION_QUEUE_CAPACITY);
+    if (registry->queue == NULL) {
+        printf("Error: malloc failed in subscription_registry_init\n");
+        exit(1);
+    }
+    registry->queue_head = 0;
+    registry->queue_size = 0;
+    registry->dropped = 0;
+    pthread_mutex_init(&registry->queue_lock, NULL);
+}
+
+/*
+  Function: subscription_register
+  Purpose:  Registers a predicate evaluated on every sighting added to a room
+            of the registry's building. Callbacks run on the inserting thread,
+            with registrations locked, so they must be quick and must not
+            register or unregister.
+  Params:
+    in/out: registry   - The building's registry.
+    in: type           - Ghost type to match, or NULL / "" for any type.
+    in: room_id        - Room id to match, or SUBSCRIPTION_ANY_ROOM.
+    in: min_likelihood - Minimum likelihood to match.
+    in: new_head_only  - Only match when the ghost becomes the head of its room.
+    in: callback       - Called for each match, or NULL to queue alerts for subscription_poll.
+    in: user           - Passed through to the callback.
+  Returns:  The subscription id, or -1 without a registry.
+*/
+int subscription_register(SubscriptionRegistry* registry, const char* type, int room_id, float min_likelihood,
+                          bool new_head_only, AlertCallback callback, void* user) {
+    if (registry == NULL) return -1;
+
+    Subscription* sub = (Subscription*) malloc(sizeof(Subscription));
+    if (sub == NULL) {
+        printf("Error: malloc failed in subscription_register\n");
+        exit(1);
+    }
+    memset(sub->type, 0, MAX_STR);
+    if (type != NULL) {
+        strncpy(sub->type, type, MAX_STR - 1);
+    }
+    sub->type_hash = subscription_hash(sub->type);
+    sub->room_id = room_id;
+    sub->min_likelihood = min_likelihood;
+    sub->new_head_only = new_head_only;
+    sub->callback = callback;
+    sub->user = user;
+
+    pthread_rwlock_wrlock(&registry->lock);
+    sub->id = registry->next_id++;
+
+    SubscriptionBucket* bucket = &(registry->buckets[subscription_bucket_index(room_id, sub->type_hash)]);
+    if (bucket->size == bucket->cap) {
+        int cap = bucket->cap == 0 ? 4 : bucket->cap * 2;
+        Subscription** grown = (Subscription**) realloc(bucket->items, sizeof(Subscription*) * cap);
+        if (grown == NULL) {
+            printf("Error: realloc failed in subscription_register\n");
+            exit(1);
+        }
+        bucket->items = grown;
+        bucket->cap = cap;
+    }
+
+    // Insert in ascending threshold order
+    int pos = bucket->size;
+    while (pos > 0 && bucket->items[pos - 1]->min_likelihood > min_likelihood) {
+        bucket->items[pos] = bucket->items[pos - 1];
+        pos--;
+    }
+    bucket->items[pos] = sub;
+    bucket->size++;
+    __atomic_store_n(&registry->count, registry->count + 1, __ATOMIC_RELEASE);
+    pthread_rwlock_unlock(&registry->lock);
+
+    return sub->id;
+}
+
+/*
+  Function: subscription_unregister
+  Purpose:  Removes a subscription.
+  Params:
+    in/out: registry - The registry it was registered with.
+    in:     id       - The id returned by subscription_register.
+  Returns:  true if the subscription existed.
+*/
+bool subscription_unregister(SubscriptionRegistry* registry, int id) {
+    if (registry == NULL) return false;
+
+    pthread_rwlock_wrlock(&registry->lock);
+    for (int b = 0; b < SUBSCRIPTION_BUCKETS; b++) {
+        SubscriptionBucket* bucket = &(registry->buckets[b]);
+        for (int i = 0; i < bucket->size; i++) {
+            if (bucket->items[i]->id != id) continue;
+
+            free(bucket->items[i]);
+            memmove(&bucket->items[i], &bucket->items[i + 1], sizeof(Subscription*) * (bucket->size - i - 1));
+            bucket->size--;
+            __atomic_store_n(&registry->count, registry->count - 1, __ATOMIC_RELEASE);
+            pthread_rwlock_unlock(&registry->lock);
+            return true;
+        }
+    }
+    pthread_rwlock_unlock(&registry->lock);
+    return false;
+}
+
+/*
+  Function: subscription_clear
+  Purpose:  Removes every subscription and discards any queued alerts.
+  Params:
+    in/out: registry - The registry to clear.
+*/
+void subscription_clear(SubscriptionRegistry* registry) {
+    if (registry == NULL) return;
+
+    pthread_rwlock_wrlock(&registry->lock);
+    for (int b = 0; b < SUBSCRIPTION_BUCKETS; b++) {
+        SubscriptionBucket* bucket = &(registry->buckets[b]);
+        for (int i = 0; i < bucket->size; i++) {
+            free(bucket->items[i]);
+        }
+        free(bucket->items);
+        bucket->items = NULL;
+        bucket->size = 0;
+        bucket->cap = 0;
+    }
+    __atomic_store_n(&registry->count, 0, __ATOMIC_RELEASE);
+    pthread_rwlock_unlock(&registry->lock);
+
+    pthread_mutex_lock(&registry->queue_lock);
+    registry->queue_head = 0;
+    registry->queue_size = 0;
+    registry->dropped = 0;
+    pthread_mutex_unlock(&registry->queue_lock);
+}
+
+/*
+  Function: subscription_registry_cleanup
+  Purpose:  Frees every subscription and the alert queue.
+  Params:
+    in/out: registry - The registry to clean up.
+*/
+void subscription_registry_cleanup(SubscriptionRegistry* registry) {
+    if (registry == NULL || registry->queue == NULL) return;
+
+    subscription_clear(registry);
+    free(registry->queue);
+    registry->queue = NULL;
+    pthread_rwlock_destroy(&registry->lock);
+    pthread_mutex_destroy(&registry->queue_lock);
+}
+
+static void subscription_deliver(SubscriptionRegistry* registry, const Subscription* sub, const AlertEvent* event) {
+    if (sub->callback != NULL) {
+        sub->callback(event, sub->user);
+        return;
+    }
+
+    pthread_mutex_lock(&registry->queue_lock);
+    if (registry->queue_size == SUBSCRIPTION_QUEUE_CAPACITY) {
+        registry->queue_head = (registry->queue_head + 1) % SUBSCRIPTION_QUEUE_CAPACITY;
+        registry->queue_size--;
+        registry->dropped++;
+    }
+    registry->queue[(registry->queue_head + registry->queue_size) % SUBSCRIPTION_QUEUE_CAPACITY] = *event;
+    registry->queue_size++;
+    pthread_mutex_unlock(&registry->queue_lock);
+}
+
+/* Fires every matching subscription in one bucket. With head_only set, only
+   new-head subscriptions are considered. */
+static void subscription_scan(SubscriptionRegistry* registry, const SubscriptionBucket* bucket, const Room* room,
+                              const Ghost* ghost, bool new_head, bool head_only, unsigned int type_hash) {
+    // Sorted by threshold, so stop at the first one the sighting doesn't reach
+    for (int i = 0; i < bucket->size && bucket->items[i]->min_likelihood <= ghost->likelihood; i++) {
+        const Subscription* sub = bucket->items[i];
+        if (sub->room_id != SUBSCRIPTION_ANY_ROOM && sub->room_id != room->id) continue;
+        if (sub->new_head_only && !new_head) continue;
+        if (head_only && !sub->new_head_only) continue;
+        if (sub->type[0] != '\0' && (sub->type_hash != type_hash || strcmp(sub->type, ghost->type) != 0)) continue;
+
+        AlertEvent event;
+        event.subscription_id = sub->id;
+        event.ghost_id = ghost->id;
+        event.room_id = room->id;
+        event.likelihood = ghost->likelihood;
+        event.new_head = new_head;
+        strcpy(event.type, ghost->type);
+        subscription_deliver(registry, sub, &event);
+    }
+}
+
+/* Scans every bucket a sighting of this type in this room can match. Two keys
+   may hash to the same bucket, so each bucket is scanned at most once. */
+static void subscription_scan_all(const Room* room, const Ghost* ghost, bool new_head, bool head_only) {
+    SubscriptionRegistry* registry = room->subscriptions;
+    unsigned int type_hash = subscription_hash(ghost->type);
+    int keys[4] = {
+        subscription_bucket_index(room->id, type_hash),
+        subscription_bucket_index(room->id, SUBSCRIPTION_ANY_TYPE_HASH),
+        subscription_bucket_index(SUBSCRIPTION_ANY_ROOM, type_hash),
+        subscription_bucket_index(SUBSCRIPTION_ANY_ROOM, SUBSCRIPTION_ANY_TYPE_HASH),
+    };
+
+    pthread_rwlock_rdlock(&registry->lock);
+    for (int k = 0; k < 4; k++) {
+        bool seen = false;
+        for (int j = 0; j < k; j++) {
+            if (keys[j] == keys[k]) seen = true;
+        }
+        if (!seen) {
+            subscription_scan(registry, &(registry->buckets[keys[k]]), room, ghost, new_head, head_only, type_hash);
+        }
+    }
+    pthread_rwlock_unlock(&registry->lock);
+}
+
+/*
+  Function: subscription_notify
+  Purpose:  Evaluates the subscriptions of the room's building for a ghost
+            just placed in the room. Rooms not added with building_add_room
+            have no registry and fire nothing.
+  Params:
+    in: room     - The room the ghost was added to.
+    in: ghost    - The ghost, with its likelihood already set.
+    in: new_head - Whether the ghost just became the head of the room's list.
+*/
+void subscription_notify(const Room* room, const Ghost* ghost, bool new_head) {
+    if (room == NULL || ghost == NULL || room->subscriptions == NULL) return;
+    if (__atomic_load_n(&room->subscriptions->count, __ATOMIC_ACQUIRE) == 0) return; // Fast path
+
+    subscription_scan_all(room, ghost, new_head, false);
+}
+
+/*
+  Function: subscription_notify_new_head
+  Purpose:  Evaluates only the new-head subscriptions for a ghost that became
+            its room's head without being added or moved itself: a deferred
+            room was flushed, or the ghost ahead of it moved down or left.
+            Its other subscriptions already ran when it was added.
+  Params:
+    in: room  - The room whose head changed.
+    in: ghost - The room's new head.
+*/
+void subscription_notify_new_head(const Room* room, const Ghost* ghost) {
+    if (room == NULL || ghost == NULL || room->subscriptions == NULL) return;
+    if (__atomic_load_n(&room->subscriptions->count, __ATOMIC_ACQUIRE) == 0) return;
+
+    subscription_scan_all(room, ghost, true, true);
+}
+
+/*
+  Function: subscription_poll
+  Purpose:  Takes the oldest queued alert.
+  Params:
+    in/out: registry - The registry to poll.
+    out:    event    - Receives the alert.
+  Returns:  true if an alert was returned, false if the queue was empty.
+*/
+bool subscription_poll(SubscriptionRegistry* registry, AlertEvent* event) {
+    if (registry == NULL || event == NULL) return false;
+
+    pthread_mutex_lock(&registry->queue_lock);
+    bool found = registry->queue_size > 0;
+    if (found) {
+        *event = registry->queue[registry->queue_head];
+        registry->queue_head = (registry->queue_head + 1) % SUBSCRIPTION_QUEUE_CAPACITY;
+        registry->queue_size--;
+    }
+    pthread_mutex_unlock(&registry->queue_lock);
+    return found;
+}
+
+/*
+  Function: subscription_dropped
+  Purpose:  Reports how many queued alerts were dropped because the queue was full.
+  Params:
+    in/out: registry - The registry to inspect.
+  Returns:  The number of dropped alerts.
+*/
+size_t subscription_dropped(SubscriptionRegistry* registry) {
+    if (registry == NULL) return 0;
+
+    pthread_mutex_lock(&registry->queue_lock);
+    size_t dropped = registry->dropped;
+    pthread_mutex_unlock(&registry->queue_lock);
+    return dropped;
+}